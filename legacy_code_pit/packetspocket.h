@@ -83,6 +83,15 @@ public:
     template<class FrameAcceptor>
     void visit(seq_key_t& last_pkt_stamp, FrameAcceptor& acceptorObject);
 
+    /** Visit whole sequences starting from the newest keyframe that is at least
+     * @param preroll_seconds old (or from the oldest buffered keyframe).
+     * Packets are visited in decoding order, without filtering by pts.
+     * @param last_pkt_stamp -- set to the stamp of the last visited packet.
+     * @return number of visited packets.
+     */
+    template<class FrameAcceptor>
+    size_t visit_preroll(double preroll_seconds, seq_key_t& last_pkt_stamp, FrameAcceptor& acceptorObject);
+
 protected:
     /** Frame sequences map. First frame in each sequence is a keyframe.*/
     typedef std::deque<TimedFrameSequencePair> multiseq_t;
@@ -110,10 +119,9 @@ void PacketsPocket::visit(seq_key_t& last_pkt_stamp, FrameAcceptor& acceptorObje
 
   auto reverseIt = frames_sequences.rbegin();
   //find last keyframe that is older then given timestamp
-  int64_t _pts = reverseIt->first.pts();
   for (;
-       reverseIt != frames_sequences.rend() && _pts >= last_pkt_stamp.pts();
-       ++reverseIt, _pts = reverseIt->first.pts())
+       reverseIt + 1 != frames_sequences.rend() && reverseIt->first.pts() >= last_pkt_stamp.pts();
+       ++reverseIt)
   {/*span to find item*/
       
   }
@@ -121,12 +129,11 @@ void PacketsPocket::visit(seq_key_t& last_pkt_stamp, FrameAcceptor& acceptorObje
   auto f_write_sequence = [&](const TimedFrameSequencePair& val, const seq_key_t& start_mark)
     {
       const PacketsSequence& deq(val.second);
-      auto cursor = deq.begin();
       for (const MarkedPacket& packet : deq)
       {
         if (packet.first.pts() < start_mark.pts())
           continue;
-        acceptorObject.operator()(cursor->second);
+        acceptorObject.operator()(packet.second);
         //I guess that there is always >= 1 element:
         last_pkt_stamp = packet.first;
       }
@@ -142,6 +149,36 @@ void PacketsPocket::visit(seq_key_t& last_pkt_stamp, FrameAcceptor& acceptorObje
 
 }
 
+template<class FrameAcceptor>
+size_t PacketsPocket::visit_preroll(double preroll_seconds, seq_key_t& last_pkt_stamp, FrameAcceptor& acceptorObject)
+{
+  if (frames_sequences.empty())
+    return 0;
+
+  const double now = frames_sequences.back().second.back().first.seconds();
+  auto reverseIt = frames_sequences.rbegin();
+  for (;
+       reverseIt + 1 != frames_sequences.rend() && now - reverseIt->first.seconds() < preroll_seconds;
+       ++reverseIt)
+  {/*span to the keyframe*/
+
+  }
+
+  size_t cnt = 0;
+  for (auto normalIterator = (reverseIt + 1).base();
+       normalIterator != frames_sequences.end();
+       ++normalIterator)
+  {
+    for (const MarkedPacket& packet : normalIterator->second)
+    {
+      acceptorObject.operator()(packet.second);
+      last_pkt_stamp = packet.first;
+      ++cnt;
+    }
+  }
+  return cnt;
+}
+
 }//namespace ZMB
 
 
@@ -48,13 +48,24 @@ bool SRPV::open(const std::string& Uri)
 
       vdec.setCodec(codec);
       vdec.setRefCountedFrames(true);
+      int lowres = ApplyDecodeProfile(vdec.raw(), decodeProfile);
 
-      vdec.open({{"threads", "1"}}, av::Codec(), ec);
-      //vdec.open(ec);
+      AVRational rate = vst.raw()->avg_frame_rate;
+      if (rate.num <= 0 || rate.den <= 0)
+        rate = vst.raw()->r_frame_rate;
+      double fps = (rate.num > 0 && rate.den > 0) ? av_q2d(rate) : 0.0;
+
+      DecoderThreading dt = threading.choose(vdec.raw(), fps, decoderThreads);
+      std::string threads = dt.threads_option();
+      vdec.open({{"threads", threads.c_str()}, {"thread_type", dt.thread_type.c_str()}}, av::Codec(), ec);
       if (ec) {
           std::cerr << "Can't open codec\n";
+          decoderThreads.reset();
           return false;
         }
+      std::cerr << objTag << ": " << vdec.raw()->width << "x" << vdec.raw()->height
+                << " @" << fps << " decoder threads: " << dt.threads << " (" << dt.thread_type << ")"
+                << " profile: " << DecodeProfileName(decodeProfile.profile) << " lowres: " << lowres << "\n";
     }
   return true;
 }
@@ -89,7 +100,51 @@ std::error_code SRPV::readPacket()
       return ec;
     }
 
+  if (gateDecoding)
+    {
+      int64_t ts_usec = ts.isNoPts() ? ZMB::MediaClock::CoarseMonotonicUsec()
+                                     : (int64_t)(ts.seconds() * 1000000.0);
+      bool is_key = pkt.isKeyPacket();
+      bool is_open = activityGate.push(pkt.size(), is_key, ts_usec);
+
+      //the decoder can only (re)start from a key frame or go on from its last packet
+      if (is_key)
+        {
+          gop.clear();
+          gopLost = false;
+        }
+      if (gopLost)
+        {
+          return ec;
+        }
+      if (!is_open)
+        {
+          if (gop.size() < maxGopPackets)
+            {
+              gop.push_back(pkt);
+            }
+          else
+            {
+              gop.clear();
+              gopLost = true;
+            }
+          return ec;
+        }
+      //catch up to this packet
+      for (av::Packet& p : gop)
+        {
+          decodePacket(p);
+        }
+      gop.clear();
+    }
+  return decodePacket(pkt);
+}
+
+std::error_code SRPV::decodePacket(av::Packet& pkt)
+{
+  decoderStats.begin();
   av::VideoFrame frame = vdec.decode(pkt, ec);
+  decoderStats.end(!ec && frame);
 
   count++;
   if (ec)
@@ -102,7 +157,6 @@ std::error_code SRPV::readPacket()
       //continue;
     }
 
-  ts = frame.pts();
 //  clog << "  Frame: " << frame.width() << "x" << frame.height() << ", size=" << frame.size() << ", ts=" << ts << ", tm: " << ts.seconds() << ", tb: " << frame.timeBase() << ", ref=" << frame.isReferenced() << ":" << frame.refCount() << std::endl;
   if (nullptr != onDecoded)
     {
@@ -5,6 +5,7 @@
 #include <map>
 #include <memory>
 #include <functional>
+#include <vector>
 
 #include "../external/avcpp/src/av.h"
 #include "../external/avcpp/src/ffmpeg.h"
@@ -22,6 +23,9 @@
 
 #include "../src/zmbaq_common/zmbaq_common.h"
 #include "../src/zmbaq_common/thread_pool.h"
+#include "../src_videoentity/decoder_policy.h"
+#include "../src_videoentity/packet_activity.h"
+#include "../src/minor/media_clock.h"
 #include <atomic>
 #include <iostream>
 
@@ -44,6 +48,9 @@ public:
     videoStream = -1;
     doesDecodePackets = true;
     count = 0;
+    gateDecoding = false;
+    maxGopPackets = 300;
+    gopLost = true;
   }
   ~SRPV()
   {
@@ -56,11 +63,21 @@ public:
 
   bool open(const std::string& Uri);
   std::error_code readPacket();
+  std::error_code decodePacket(av::Packet& pkt);
 
   std::string objTag;
   std::string uri;
 
   ssize_t videoStream;
+
+  /** Set before open(). */
+  DecoderThreadingPolicy threading;
+  /** Set before open(). Analysis for the detector-only streams.*/
+  DecodeProfileParams decodeProfile;
+  /** Decoder's share of the process-wide DecoderCoreBudget, outlives the vdec.*/
+  DecoderThreadsLease decoderThreads;
+  DecoderStats decoderStats;
+
   av::VideoDecoderContext vdec;
   av::Stream      vst;
   std::error_code   ec;
@@ -68,6 +85,16 @@ public:
   bool doesDecodePackets;
   size_t count;
 
+  /** Decode only while activityGate is open (packet sizes rise), requires doesDecodePackets.*/
+  bool gateDecoding;
+  PacketActivityGate activityGate;
+  /** Packets the decoder has not got, since its last packet or since the last key frame:
+   * decoded when the gate opens.*/
+  std::vector<av::Packet> gop;
+  size_t maxGopPackets;
+  /** A packet after the last key frame was dropped (gop overflow): wait for a key frame.*/
+  bool gopLost;
+
   /** By default has 1 thread if imbue(neuPool) was not called.*/
   std::shared_ptr<ZMBCommon::ThreadsPool> pool;
 
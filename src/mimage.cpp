@@ -15,17 +15,29 @@ You should have received a copy of the GNU Affero General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 
 #include "mimage.h"
+#include "picture.h"
+
+#include <algorithm>
+
+extern "C"
+{
+#include "libavutil/pixdesc.h"
+}
 
 bool operator < (const ZMB::MRegion& lhs, const ZMB::MRegion& rhs)
 {
     auto sl = lhs.square();
-    auto sr = lhs.square();
+    auto sr = rhs.square();
 
-    if (sl < sr)
-        return true;
-    else if (sl == sr)
+    if (sl != sr)
+        return sl < sr;
+    if (lhs.left() != rhs.left())
         return lhs.left() < rhs.left();
-    return false;
+    if (lhs.bottom() != rhs.bottom())
+        return lhs.bottom() < rhs.bottom();
+    if (lhs.right() != rhs.right())
+        return lhs.right() < rhs.right();
+    return lhs.top() < rhs.top();
 }
 
 namespace ZMB {
@@ -74,10 +86,18 @@ int MRegion::right() const {return bottom_right().x;}
 int MRegion::top() const {return top_left().y;}
 int MRegion::bottom() const {return bottom_right().y;}
 
+MRegion MakeRegion(int x, int y, int w, int h)
+{
+    MRegion r;
+    r.top_left() = glm::ivec2(x, y + h);
+    r.bottom_right() = glm::ivec2(x + w, y);
+    return r;
+}
+
 //-----------------------------------------------------------------------------
 void FrameDeleter::operator()(AVFrame* pframe) const
 {
-    av_frame_unref(pframe);
+    av_frame_free(&pframe);
 }
 void SwsDeleter::operator()(struct SwsContext* ctx)
 {
@@ -90,6 +110,7 @@ static void InitFromFrame(PictureHolder& ph, AVFrame* frame_p)
     ::memcpy(ph.dataSlicesArray.data(), frame_p->data, sizeof(frame_p->data));
     ::memcpy(ph.stridesArray.data(), frame_p->linesize, sizeof(frame_p->linesize));
     ph.format = frame_p->format;
+    ph.dimension = MSize(frame_p->width, frame_p->height);
 }
 
 PictureHolder::PictureHolder(PictureHolder&& rvalue) : PictureHolder()
@@ -106,6 +127,7 @@ PictureHolder::PictureHolder(PictureHolder&& rvalue) : PictureHolder()
         stridesArray = std::move(rvalue.stridesArray);
         rvalue.stridesArray.fill(0x00);
     }
+    parent = std::move(rvalue.parent);
     format = rvalue.format; rvalue.format = -1;
     dimension = rvalue.dimension; rvalue.dimension = MSize(0,0);
     swsContextPtr.reset(rvalue.swsContextPtr.release());
@@ -129,6 +151,67 @@ int PictureHolder::width() const {return dimension.width();}
 int PictureHolder::height() const {return dimension.height();}
 
 
+/** CropView() of the formats without a PixFmt: the layout from the descriptor.*/
+static bool CropPlanes(PictureHolder& view, const PictureHolder& pic, int x, int y, int w, int h)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)pic.format);
+    if (nullptr == desc || 0 != (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM)))
+        return false;
+
+    int x1 = std::min(pic.width(), x + w);
+    int y1 = std::min(pic.height(), y + h);
+    x = std::max(0, x) & ~((1 << desc->log2_chroma_w) - 1);
+    y = std::max(0, y) & ~((1 << desc->log2_chroma_h) - 1);
+    if (x1 <= x || y1 <= y)
+        return false;
+
+    //bytes of x pixels in each plane
+    int x_bytes[4] = {0, 0, 0, 0};
+    if (av_image_fill_linesizes(x_bytes, (AVPixelFormat)pic.format, x) < 0)
+        return false;
+
+    const bool has_chroma_planes = 0 == (desc->flags & AV_PIX_FMT_FLAG_RGB) && desc->nb_components >= 3;
+    for (int p = 0; p < 4 && nullptr != pic.dataSlicesArray[p]; ++p)
+    {
+        int rows = (has_chroma_planes && (1 == p || 2 == p)) ? (y >> desc->log2_chroma_h) : y;
+        view.dataSlicesArray[p] = pic.dataSlicesArray[p] + (ptrdiff_t)rows * pic.stridesArray[p] + x_bytes[p];
+        view.stridesArray[p] = pic.stridesArray[p];
+    }
+    view.dimension = MSize(x1 - x, y1 - y);
+    return true;
+}
+
+PictureHolder CropView(const PictureSharedPtr& parent, int x, int y, int w, int h)
+{
+    PictureHolder view;
+    if (nullptr == parent || nullptr == parent->dataSlicesArray[0])
+        return view;
+    //set first: the destructor of a view must not free the planes
+    view.parent = parent;
+    view.format = parent->format;
+
+    auto fn_typed = [&view, x, y, w, h](const auto& typed)
+    {
+        auto c = typed.crop(x, y, w, h);
+        for (int p = 0; p < c.PLANES; ++p)
+        {
+            view.dataSlicesArray[p] = c.data[p];
+            view.stridesArray[p] = c.strides[p];
+        }
+        view.dimension = c.dimension;
+    };
+    if (!VisitPicture(*parent, fn_typed) && !CropPlanes(view, *parent, x, y, w, h))
+        return PictureHolder();
+    if (nullptr == view.dataSlicesArray[0])
+        return PictureHolder();
+    return view;
+}
+
+PictureHolder CropView(const PictureSharedPtr& parent, const MRegion& region)
+{
+    return CropView(parent, region.left(), region.bottom(), region.width(), region.height());
+}
+
 PictureHolder CreatePicture(MSize dim, int avpic_fmt)
 {
     PictureHolder ph;
@@ -170,6 +253,24 @@ PictureHolder&& PictureHolder::Scale(int destination_av_fmt, MSize destinationDi
               );
     return std::move(dst);
 }
+
+bool ScalePicture(PictureHolder& destination, const PictureHolder& picture, SwsUniquePtr& rSwsContext)
+{
+    struct SwsContext* ctx = sws_getCachedContext(rSwsContext.release(),
+                                                  picture.width(), picture.height(), (enum AVPixelFormat)picture.fmt(),
+                                                  destination.width(), destination.height(), (enum AVPixelFormat)destination.fmt(),
+                                                  SWS_FAST_BILINEAR, NULL, NULL, NULL);
+    rSwsContext.reset(ctx);
+    if (nullptr == ctx)
+        return false;
+
+    sws_scale(ctx,
+              picture.dataSlicesArray.data(), picture.stridesArray.data(), //< src {data, strides}
+              0/*src slice Y*/, picture.height()/*src slice height*/,
+              destination.dataSlicesArray.data(), destination.stridesArray.data() //< dst {data, strides}
+              );
+    return true;
+}
 //-----------------------------------------------------------------------------
 
 
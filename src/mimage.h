@@ -88,11 +88,16 @@ struct MRegion : public glm::tmat2x2<int, glm::highp>
 
 bool operator < (const ZMB::MRegion& lhs, const ZMB::MRegion& rhs);
 
+/** Region of an image's rectangle: (x, y) are it's first column and row, (w x h) pixels.
+ * MRegion's y axis points up (height = top - bottom) while the image rows go down,
+ * so the first row is the region's bottom() and the top() is past the last row.*/
+MRegion MakeRegion(int x, int y, int w, int h);
+
 //-----------------------------------------------------------------------------
-/** Default deleter (av_frame_unref(frame)).*/
+/** Default deleter (av_frame_free(&frame)), the frame must be allocated by av_frame_alloc()/av_frame_clone().*/
 struct FrameDeleter
 {
-    //makes av_frame_unref(pframe)
+    //makes av_frame_free(&pframe), it also unreferences the buffers
     void operator()(AVFrame* pframe) const;
 };
 typedef std::unique_ptr<AVFrame, FrameDeleter> AVFrameUniquePtr;
@@ -124,7 +129,7 @@ public:
 
     virtual ~PictureHolder()
     {
-        if ( nullptr == frame_p )
+        if ( nullptr == frame_p && nullptr == parent )
         {
             av_freep(dataSlicesArray.data());
             dataSlicesArray.fill(0x00);
@@ -152,17 +157,37 @@ public:
     //this field used only when you explicitly MImage::imbue(frame) with a deleter
     AVFrameUniquePtr frame_p;
 
+    //set for the views (see CropView()): the planes are the parent's, it's kept alive and nothing is freed
+    std::shared_ptr<const PictureHolder> parent;
+
     //used for conversion
     SwsUniquePtr swsContextPtr;
     int lastUsedDestFormat = -1;
     MSize lastUsedDestDimension = MSize(0, 0);
 };
+/** Decoded pictures are shared read-only between the pipeline stages.*/
+typedef std::shared_ptr<const PictureHolder> PictureSharedPtr;
 //-----------------------------------------------------------------------------
+/** Zero-copy view of (w x h) pixels at (x, y) of the (parent), clipped:
+ * the planes' pointers are offset, the strides are the parent's, the view shares it's ownership.
+ * (x, y) are rounded down to the chroma grid, so the chroma planes start at the same pixels.
+ * @return an empty picture for an empty region or for the formats without addressable
+ * planes (hardware, paletted, bitstream). */
+PictureHolder CropView(const PictureSharedPtr& parent, int x, int y, int w, int h);
+
+/** Same for a region of the frame, see MakeRegion().*/
+PictureHolder CropView(const PictureSharedPtr& parent, const MRegion& region);
+
 /** Alloc new image data of given dimensions and format. */
 PictureHolder CreatePicture(MSize dim, /*(AVPixelFormat)*/int avpic_fmt);
 
 /** Make scaled data from other picture */
 PictureHolder ScalePicture(const PictureHolder& picture, SwsUniquePtr& rSwsContext);
+
+/** Convert (picture) into preallocated (destination), it's format and dimension
+ * define the conversion. The context is created or re-used via sws_getCachedContext().
+ * @return FALSE if there is no conversion for given formats. */
+bool ScalePicture(PictureHolder& destination, const PictureHolder& picture, SwsUniquePtr& rSwsContext);
 //-----------------------------------------------------------------------------
 
 }//ZMB
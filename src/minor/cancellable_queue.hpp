@@ -0,0 +1,185 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CANCELLABLE_QUEUE_HPP
+#define CANCELLABLE_QUEUE_HPP
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+namespace ZMB {
+
+/** Bounded queue between the producers and one consumer task that may be cancelled.
+ *
+ * push() never blocks: when the queue is full either the oldest item is dropped
+ * (the newest is worth more, e.g. the frames) or the new one is refused (e.g. the crops,
+ * stale already when the consumer is that far behind).
+ * The consumer waits in pop()/pop_batch() and re-checks (cancelled) every CANCEL_POLL_PERIOD,
+ * or at once when woken up by wake_all() after the task's cancel().*/
+template<typename T>
+class CancellableQueue
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum Overflow
+    {
+        DropOldest,
+        RefuseNewest
+    };
+
+    /** How often the waiting consumer re-checks for cancellation.*/
+    static constexpr std::chrono::milliseconds CANCEL_POLL_PERIOD{100};
+
+    CancellableQueue(size_t capacity, Overflow overflow)
+        : queue_capacity(capacity > 0 ? capacity : 1), overflow(overflow)
+    {
+
+    }
+
+    CancellableQueue(const CancellableQueue&) = delete;
+    CancellableQueue& operator = (const CancellableQueue&) = delete;
+
+    /** Enqueue, never blocks. (fill) receives the queue's size after the push.
+     * @return FALSE if the queue was full and an item (the oldest or this one) was lost.*/
+    bool push(T item, size_t* fill = nullptr)
+    {
+        bool has_room = true;
+        bool wake = false;
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            if (items.size() >= queue_capacity)
+            {
+                has_room = false;
+                if (RefuseNewest == overflow)
+                {
+                    if (nullptr != fill)
+                        *fill = items.size();
+                    return false;
+                }
+                items.pop_front();
+            }
+            items.push_back(Entry{std::move(item), Clock::now()});
+            //a batching consumer doesn't need a wake up per item
+            wake = 1 == items.size() || items.size() >= batch_wanted;
+            if (nullptr != fill)
+                *fill = items.size();
+        }
+        if (wake)
+            cond.notify_one();
+        return has_room;
+    }
+
+    /** Wait for the next item until (cancelled)() returns TRUE.
+     * (left) receives the number of items still queued.
+     * @return FALSE when cancelled.*/
+    template<typename Cancelled>
+    bool pop(T& item, Cancelled cancelled, size_t* left = nullptr)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        if (!wait_any(lk, cancelled))
+            return false;
+        item = std::move(items.front().item);
+        items.pop_front();
+        if (nullptr != left)
+            *left = items.size();
+        return true;
+    }
+
+    /** Wait for the first item, then let the batch fill up to (max_items),
+     * but not longer than (max_wait) after the oldest item was pushed.
+     * @return FALSE when cancelled.*/
+    template<typename Cancelled>
+    bool pop_batch(std::vector<T>& batch, size_t max_items, std::chrono::milliseconds max_wait,
+                   Cancelled cancelled, size_t* left = nullptr)
+    {
+        batch.clear();
+        std::unique_lock<std::mutex> lk(mutex);
+        if (!wait_any(lk, cancelled))
+            return false;
+        batch_wanted = max_items;
+        Clock::time_point deadline = items.front().pushed + max_wait;
+        while (items.size() < max_items && !cancelled())
+        {
+            if (std::cv_status::timeout == cond.wait_until(lk, deadline))
+                break;
+        }
+        batch_wanted = 1;
+        if (cancelled())
+            return false;
+
+        size_t n = std::min(max_items, items.size());
+        for (size_t c = 0; c < n; ++c)
+        {
+            batch.push_back(std::move(items.front().item));
+            items.pop_front();
+        }
+        if (nullptr != left)
+            *left = items.size();
+        return true;
+    }
+
+    /** Wake up the waiting consumer, e.g. from the task's cancel().*/
+    void wake_all() {cond.notify_all();}
+
+    void clear()
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        items.clear();
+    }
+
+    size_t capacity() const {return queue_capacity;}
+
+private:
+    struct Entry
+    {
+        T item;
+        Clock::time_point pushed;
+    };
+
+    template<typename Cancelled>
+    bool wait_any(std::unique_lock<std::mutex>& lk, Cancelled& cancelled)
+    {
+        while (items.empty())
+        {
+            if (cancelled())
+                return false;
+            cond.wait_for(lk, CANCEL_POLL_PERIOD);
+        }
+        return !cancelled();
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Entry> items;
+    const size_t queue_capacity;
+    const Overflow overflow;
+    size_t batch_wanted = 1;//< guarded by the mutex
+};
+
+template<typename T>
+constexpr std::chrono::milliseconds CancellableQueue<T>::CANCEL_POLL_PERIOD;
+
+}//ZMB
+
+#endif // CANCELLABLE_QUEUE_HPP
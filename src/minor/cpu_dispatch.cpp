@@ -0,0 +1,80 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "cpu_dispatch.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <strings.h>
+
+namespace ZMB {
+
+static const char* const SIMD_NAMES[] = {"scalar", "sse2", "avx2", "avx512"};
+static const char* const SIMD_ENV = "ZMBAQ_SIMD";
+
+const char* SimdName(SimdLevel level)
+{
+    return SIMD_NAMES[(int)level];
+}
+
+SimdLevel DetectSimd()
+{
+#if ZMB_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SimdLevel::SSE2;
+#endif
+    return SimdLevel::SCALAR;
+}
+
+static SimdLevel ResolveSimd()
+{
+    SimdLevel detected = DetectSimd();
+    SimdLevel res = detected;
+    const char* env = std::getenv(SIMD_ENV);
+    if (nullptr != env && '\0' != env[0])
+    {
+        int found = -1;
+        for (int c = 0; c <= (int)SimdLevel::AVX512; ++c)
+        {
+            if (0 == strcasecmp(env, SIMD_NAMES[c]))
+                found = c;
+        }
+        if (found < 0)
+            std::cerr << SIMD_ENV << "=" << env << " is unknown, expected scalar|sse2|avx2|avx512\n";
+        else if (found > (int)detected)
+            std::cerr << SIMD_ENV << "=" << env << " is not supported by the CPU\n";
+        else
+            res = (SimdLevel)found;
+    }
+    std::cerr << "SIMD kernels: " << SimdName(res) << " (CPU: " << SimdName(detected) << ")\n";
+    return res;
+}
+
+SimdLevel ActiveSimd()
+{
+    static const SimdLevel level = ResolveSimd();
+    return level;
+}
+
+}//ZMB
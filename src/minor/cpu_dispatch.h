@@ -0,0 +1,72 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+/** The kernels' ISA variants are compiled with the target attributes next to the
+ * baseline ones (x86 with GCC or Clang), the build flags stay at the baseline.*/
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ZMB_SIMD_X86 1
+#define ZMB_TARGET_AVX2 __attribute__((target("avx2")))
+#define ZMB_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define ZMB_SIMD_X86 0
+#endif
+
+namespace ZMB {
+
+/** Instruction set levels of the SIMD kernels, each one includes the previous ones.*/
+enum class SimdLevel : int
+{
+    SCALAR = 0,
+    SSE2,
+    AVX2,
+    AVX512//< F and BW
+};
+
+/** The best level of this CPU (cpuid, OS support of the registers included).*/
+SimdLevel DetectSimd();
+
+/** The level the kernels run at: the detected one, lowered by the environment variable
+ * ZMBAQ_SIMD=scalar|sse2|avx2|avx512 (to compare the paths or to avoid a broken one).
+ * Resolved once, on the first call, the choice is logged to std::cerr. Thread-safe.*/
+SimdLevel ActiveSimd();
+
+const char* SimdName(SimdLevel level);
+
+/** Pick the kernel for ActiveSimd(): the best one that isn't NULL and not above the level.
+ * The scalar one must be given.*/
+template<typename Fn>
+Fn SelectKernel(Fn scalar, Fn sse2, Fn avx2 = nullptr, Fn avx512 = nullptr)
+{
+    SimdLevel lvl = ActiveSimd();
+    if (lvl >= SimdLevel::AVX512 && nullptr != avx512)
+        return avx512;
+    if (lvl >= SimdLevel::AVX2 && nullptr != avx2)
+        return avx2;
+    if (lvl >= SimdLevel::SSE2 && nullptr != sse2)
+        return sse2;
+    return scalar;
+}
+
+}//ZMB
+
+#endif // CPU_DISPATCH_H
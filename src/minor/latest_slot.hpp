@@ -0,0 +1,129 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LATEST_SLOT_HPP
+#define LATEST_SLOT_HPP
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace ZMB {
+
+/** The newest of the values published by one writer, for any number of readers,
+ * without locks: a reader never blocks the writer and the writer never waits for the readers.
+ *
+ * The values (refcounted, e.g. the decoded frames) live in SLOTS slots. The writer fills a slot
+ * that is neither the current one nor pinned by a reader, then makes it current.
+ * A reader pins the current slot, re-checks that it's still current (the version,
+ * as a seqlock's sequence), copies the shared pointer and unpins: a pinned slot is never
+ * rewritten, a rewritten slot fails the check and the reader retries.
+ * With more than (SLOTS - 2) readers inside get() at once, a publish() may find no free
+ * slot: the value is dropped then (see dropped()), the next one supersedes it anyway.
+ *
+ * The old values are released by the writer when their slots are reused.*/
+template<typename T, int SLOTS = 8>
+class LatestSlot
+{
+public:
+    typedef std::shared_ptr<const T> ValuePtr;
+
+    LatestSlot()
+    {
+        for (Slot& s : slots)
+            s.pins.store(0);
+        current.store(0);
+        drop_cnt.store(0);
+    }
+
+    LatestSlot(const LatestSlot&) = delete;
+    LatestSlot& operator = (const LatestSlot&) = delete;
+
+    /** Make (value) the newest one, the writer's thread only.
+     * @return FALSE if all the slots were pinned and the value was dropped.*/
+    bool publish(ValuePtr value)
+    {
+        uint64_t cur = current.load(std::memory_order_relaxed);
+        int cur_idx = Index(cur);
+        for (int c = 1; c < SLOTS; ++c)
+        {
+            int idx = (cur_idx + c) % SLOTS;
+            Slot& s(slots[idx]);
+            //pairs with the reader's pin-then-check: either the reader sees the slot isn't current,
+            //or we see it's pinned
+            if (0 != s.pins.load(std::memory_order_seq_cst))
+                continue;
+            s.value = std::move(value);
+            current.store(Pack(Version(cur) + 1, idx), std::memory_order_seq_cst);
+            return true;
+        }
+        drop_cnt.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /** The newest value, NULL before the first publish(). Any thread, lock-free.*/
+    ValuePtr get() const
+    {
+        for (;;)
+        {
+            uint64_t cur = current.load(std::memory_order_seq_cst);
+            if (0 == Version(cur))
+                return nullptr;
+            const Slot& s(slots[Index(cur)]);
+            s.pins.fetch_add(1, std::memory_order_seq_cst);
+            if (current.load(std::memory_order_seq_cst) == cur)
+            {//still current: the writer won't touch it until we unpin
+                ValuePtr res(s.value);
+                s.pins.fetch_sub(1, std::memory_order_release);
+                return res;
+            }
+            s.pins.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    /** Number of the values published, a reader may compare it with the last one it's seen
+     * to skip get() when nothing is new.*/
+    uint64_t version() const {return Version(current.load(std::memory_order_acquire));}
+
+    /** Values dropped by publish() for the lack of a free slot.*/
+    uint64_t dropped() const {return drop_cnt.load(std::memory_order_relaxed);}
+
+private:
+    static_assert(SLOTS >= 3 && SLOTS <= 256, "one current slot, one being written, the rest may be pinned");
+
+    struct Slot
+    {
+        mutable std::atomic<uint32_t> pins;
+        ValuePtr value;
+    };
+
+    //version in the high bits, the slot's index in the low byte
+    static uint64_t Pack(uint64_t version, int idx) {return (version << 8) | (uint64_t)idx;}
+    static uint64_t Version(uint64_t packed) {return packed >> 8;}
+    static int Index(uint64_t packed) {return (int)(packed & 0xFF);}
+
+    std::array<Slot, SLOTS> slots;
+    std::atomic<uint64_t> current;
+    std::atomic<uint64_t> drop_cnt;
+};
+
+}//ZMB
+
+#endif // LATEST_SLOT_HPP
@@ -0,0 +1,127 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MEDIA_CLOCK_H
+#define MEDIA_CLOCK_H
+
+#include <cstdint>
+#include <chrono>
+#include "timer_wheel.h"
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+namespace ZMB {
+
+/** Time source shared by all the timers of one video stream (microseconds).
+ * It's moved forward explicitly: from frame's PTS when replaying a recording,
+ * or by tick() from the coarse system clock when running live.
+ * The time never goes backwards, so the delays it drives are deterministic
+ * and independent of the processing speed.
+ * Not thread-safe: read and advanced by the stream's processing thread.
+ */
+class MediaClock
+{
+public:
+    explicit MediaClock(int64_t tick_usec = 1000)
+        : now_usec(0), epoch_offset(0), has_epoch(false), resets_cnt(0), wheel(tick_usec, 0)
+    {  }
+
+    int64_t now() const {return now_usec;}
+
+    /** now() as microseconds since the Epoch, for the timestamps leaving the process:
+     * the offset to the Epoch is read once, at the first advance after reset(),
+     * so the system time's steps don't move the media time.*/
+    int64_t wall_usec() const {return now_usec + epoch_offset;}
+
+    /** Move forward to given media time, fire the expired timers.*/
+    void advance_to(int64_t usec)
+    {
+        if (!has_epoch)
+        {
+            epoch_offset = CoarseRealtimeUsec() - usec;
+            has_epoch = true;
+        }
+        if (usec <= now_usec)
+            return;
+        now_usec = usec;
+        wheel.advance(now_usec);
+    }
+
+    /** Live mode: advance from the coarse monotonic clock.*/
+    void tick() { advance_to(CoarseMonotonicUsec()); }
+
+    /** Start over (new stream, seek), drops all timers.*/
+    void reset(int64_t usec = 0)
+    {
+        now_usec = usec;
+        has_epoch = false;
+        ++resets_cnt;
+        wheel.reset(usec);
+    }
+
+    /** Number of reset() calls: the timers scheduled before a reset never fire.*/
+    uint64_t resets() const {return resets_cnt;}
+
+    /** Call (cb) when the clock reaches now() + (delay_usec).*/
+    TimerWheel::TimerId schedule_in(int64_t delay_usec, TimerWheel::Callback cb)
+        { return wheel.schedule(now_usec + delay_usec, std::move(cb)); }
+
+    TimerWheel& timers() {return wheel;}
+
+    /** Microseconds of a monotonic clock (not the Epoch: it doesn't jump with the system time),
+     * read without a syscall where possible (vDSO).
+     * Resolution is a scheduler tick, good enough for frame-rate timing.*/
+    static int64_t CoarseMonotonicUsec()
+    {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /** Microseconds since the Epoch, coarse as above.*/
+    static int64_t CoarseRealtimeUsec()
+    {
+#if defined(__linux__) && defined(CLOCK_REALTIME_COARSE)
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+private:
+    int64_t now_usec;
+    int64_t epoch_offset;//< wall_usec() - now()
+    bool has_epoch;
+    uint64_t resets_cnt;
+    TimerWheel wheel;
+};
+
+}//ZMB
+
+#endif // MEDIA_CLOCK_H
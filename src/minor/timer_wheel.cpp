@@ -0,0 +1,215 @@
+/*A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+
+#include "timer_wheel.h"
+#include <cassert>
+
+namespace ZMB {
+
+static constexpr uint64_t SLOT_MASK = TimerWheel::SLOTS - 1;
+/** Node's level while it's slot is being fired.*/
+static constexpr int16_t FIRING_LEVEL = -2;
+/** Farthest deadline the top level can hold, further ones are re-cascaded.*/
+static constexpr uint64_t MAX_SPAN = (1ull << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS)) - 1;
+
+TimerWheel::TimerWheel(int64_t tick_usec, int64_t start_usec)
+    : current_tick(0), tick_usec(tick_usec > 0 ? tick_usec : 1), count(0)
+{
+    reset(start_usec);
+}
+
+void TimerWheel::reset(int64_t start_usec)
+{
+    for (auto& level : heads)
+        level.fill(-1);
+    //keep the nodes' generations: the forgotten timers' ids must not cancel the new ones
+    free_nodes.clear();
+    for (int32_t idx = (int32_t)nodes.size() - 1; idx >= 0; --idx)
+    {
+        Node& n(nodes[idx]);
+        if (-1 != n.level)
+        {
+            n.cb = nullptr;
+            ++n.generation;
+            n.level = -1;
+        }
+        free_nodes.push_back(idx);
+    }
+    count = 0;
+    current_tick = start_usec > 0 ? (uint64_t)(start_usec / tick_usec) : 0;
+}
+
+TimerWheel::TimerId TimerWheel::schedule(int64_t deadline_usec, Callback cb)
+{
+    int32_t idx;
+    if (!free_nodes.empty())
+    {
+        idx = free_nodes.back();
+        free_nodes.pop_back();
+    }
+    else
+    {
+        idx = (int32_t)nodes.size();
+        nodes.emplace_back();
+    }
+    Node& n(nodes[idx]);
+    n.cb = std::move(cb);
+    //round up: never fire before the deadline
+    n.deadline_tick = deadline_usec > 0 ? (uint64_t)((deadline_usec + tick_usec - 1) / tick_usec) : 0;
+    //current tick is already processed
+    insert(idx, current_tick + 1);
+    ++count;
+    return ((TimerId)n.generation << 32) | (uint32_t)idx;
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    int32_t idx = (int32_t)(id & 0xFFFFFFFFu);
+    uint32_t generation = (uint32_t)(id >> 32);
+    if (idx < 0 || idx >= (int32_t)nodes.size())
+        return false;
+
+    Node& n(nodes[idx]);
+    if (n.generation != generation || -1 == n.level)
+        return false;
+
+    if (FIRING_LEVEL != n.level)
+        unlink(idx);
+    n.level = -1;
+    release(idx);
+    return true;
+}
+
+void TimerWheel::insert(int32_t idx, uint64_t min_tick)
+{
+    Node& n(nodes[idx]);
+    uint64_t tick = n.deadline_tick < min_tick ? min_tick : n.deadline_tick;
+    uint64_t delta = tick - current_tick;
+    if (delta > MAX_SPAN)
+    {//will be re-inserted with the real deadline when cascaded
+        tick = current_tick + MAX_SPAN;
+        delta = MAX_SPAN;
+    }
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1))))
+        ++level;
+
+    int slot = (int)((tick >> (SLOT_BITS * level)) & SLOT_MASK);
+    n.level = (int16_t)level;
+    n.slot = (int16_t)slot;
+    n.prev = -1;
+    n.next = heads[level][slot];
+    if (n.next >= 0)
+        nodes[n.next].prev = idx;
+    heads[level][slot] = idx;
+}
+
+void TimerWheel::unlink(int32_t idx)
+{
+    Node& n(nodes[idx]);
+    assert(n.level >= 0);
+    if (n.prev >= 0)
+        nodes[n.prev].next = n.next;
+    else
+        heads[n.level][n.slot] = n.next;
+    if (n.next >= 0)
+        nodes[n.next].prev = n.prev;
+    n.prev = n.next = -1;
+    n.level = n.slot = -1;
+}
+
+void TimerWheel::release(int32_t idx)
+{
+    Node& n(nodes[idx]);
+    n.cb = nullptr;
+    ++n.generation;
+    free_nodes.push_back(idx);
+    --count;
+}
+
+void TimerWheel::cascade(int level)
+{
+    int slot = (int)((current_tick >> (SLOT_BITS * level)) & SLOT_MASK);
+    int32_t idx = heads[level][slot];
+    heads[level][slot] = -1;
+    while (idx >= 0)
+    {
+        int32_t next = nodes[idx].next;
+        insert(idx, current_tick);
+        idx = next;
+    }
+}
+
+size_t TimerWheel::advance(int64_t now_usec)
+{
+    if (now_usec < 0)
+        return 0;
+    uint64_t target = (uint64_t)(now_usec / tick_usec);
+    size_t fired = 0;
+
+    while (current_tick < target)
+    {
+        if (0 == count)
+        {//nothing to wait for, jump
+            current_tick = target;
+            break;
+        }
+        ++current_tick;
+
+        //lower level wrapped around: move the timers of the upper level's slot down
+        for (int level = 1; level < LEVELS; ++level)
+        {
+            if (0 != ((current_tick >> (SLOT_BITS * (level - 1))) & SLOT_MASK))
+                break;
+            cascade(level);
+        }
+
+        int slot = (int)(current_tick & SLOT_MASK);
+        int32_t idx = heads[0][slot];
+        heads[0][slot] = -1;
+
+        //detach the whole slot first: the callbacks may schedule or cancel timers
+        due.clear();
+        while (idx >= 0)
+        {
+            Node& n(nodes[idx]);
+            due.push_back(std::make_pair(idx, n.generation));
+            idx = n.next;
+            n.prev = n.next = -1;
+            n.level = FIRING_LEVEL;
+            n.slot = -1;
+        }
+
+        for (size_t c = 0; c < due.size(); ++c)
+        {
+            Node& n(nodes[due[c].first]);
+            if (n.generation != due[c].second)
+                continue;//cancelled by one of the previous callbacks
+
+            Callback cb = std::move(n.cb);
+            n.level = -1;
+            release(due[c].first);
+            ++fired;
+            if (cb)
+                cb();
+        }
+    }
+    return fired;
+}
+
+}//ZMB
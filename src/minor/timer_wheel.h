@@ -0,0 +1,96 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <functional>
+
+namespace ZMB {
+
+/** Hierarchical timer wheel: 4 levels of 64 slots.
+ * Time is not read from the system, it's provided by advance() calls,
+ * so the wheel runs as fast as the media timestamps go.
+ * schedule()/cancel() are O(1), advance() is O(elapsed ticks + fired timers).
+ * Not thread-safe: the owner's thread schedules and advances.
+ */
+class TimerWheel
+{
+public:
+    typedef std::function<void()> Callback;
+    typedef uint64_t TimerId;
+
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+    static constexpr TimerId INVALID_TIMER = 0;
+
+    /** @param tick_usec -- resolution of the wheel.
+     *  @param start_usec -- initial time.*/
+    explicit TimerWheel(int64_t tick_usec = 1000, int64_t start_usec = 0);
+
+    /** Call (cb) from advance() when the time reaches (deadline_usec).
+     * Deadlines in the past fire on the next advance().*/
+    TimerId schedule(int64_t deadline_usec, Callback cb);
+
+    /** @return FALSE if the timer has already fired or was cancelled.*/
+    bool cancel(TimerId id);
+
+    /** Move time forward and fire the expired timers. Backward moves are ignored.
+     * @return number of fired timers.*/
+    size_t advance(int64_t now_usec);
+
+    /** Forget all timers, restart from given time.*/
+    void reset(int64_t start_usec);
+
+    size_t size() const {return count;}
+    int64_t now() const {return current_tick * tick_usec;}
+    int64_t resolution() const {return tick_usec;}
+
+private:
+    struct Node
+    {
+        Callback cb;
+        uint64_t deadline_tick = 0;
+        uint32_t generation = 1;
+        int32_t prev = -1, next = -1;
+        int16_t level = -1, slot = -1;
+    };
+
+    void insert(int32_t idx, uint64_t min_tick);
+    void unlink(int32_t idx);
+    void cascade(int level);
+    void release(int32_t idx);
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> free_nodes;
+    std::vector<std::pair<int32_t, uint32_t>> due;//< (index, generation) of the firing slot
+    std::array<std::array<int32_t, SLOTS>, LEVELS> heads;
+    uint64_t current_tick;
+    int64_t tick_usec;
+    size_t count;
+};
+
+}//ZMB
+
+#endif // TIMER_WHEEL_H
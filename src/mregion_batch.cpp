@@ -0,0 +1,329 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "mregion_batch.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace ZMB {
+
+void MRegionBatch::clear()
+{
+    l.clear(); b.clear(); r.clear(); t.clear();
+}
+
+void MRegionBatch::reserve(size_t n)
+{
+    l.reserve(n); b.reserve(n); r.reserve(n); t.reserve(n);
+}
+
+void MRegionBatch::resize(size_t n)
+{
+    l.resize(n); b.resize(n); r.resize(n); t.resize(n);
+}
+
+void MRegionBatch::push_back(const MRegion& reg)
+{
+    push_back(reg.left(), reg.bottom(), reg.right(), reg.top());
+}
+
+void MRegionBatch::push_back(int left, int bottom, int right, int top)
+{
+    l.push_back(left);
+    b.push_back(bottom);
+    r.push_back(right);
+    t.push_back(top);
+}
+
+void MRegionBatch::assign(const MRegion* regions, size_t n)
+{
+    clear();
+    reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        push_back(regions[i]);
+}
+
+MRegion MRegionBatch::at(size_t i) const
+{
+    return MakeRegion(l[i], b[i], r[i] - l[i], t[i] - b[i]);
+}
+
+void MRegionBatch::to_regions(std::vector<MRegion>& out) const
+{
+    out.resize(size());
+    for (size_t i = 0; i < size(); ++i)
+        out[i] = at(i);
+}
+
+//-----------------------------------------------------------------------------
+namespace {
+
+#ifdef __SSE2__
+struct Quad
+{
+    __m128i l, b, r, t;
+};
+
+/** SSE4.1's _mm_max_epi32()/_mm_min_epi32() in SSE2.*/
+inline __m128i Max32(__m128i x, __m128i y)
+{
+    __m128i gt = _mm_cmpgt_epi32(x, y);
+    return _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, y));
+}
+
+inline __m128i Min32(__m128i x, __m128i y)
+{
+    __m128i gt = _mm_cmpgt_epi32(x, y);
+    return _mm_or_si128(_mm_and_si128(gt, y), _mm_andnot_si128(gt, x));
+}
+
+inline __m128i Load(const int* p)
+{
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+inline void Store(int* p, __m128i v)
+{
+    _mm_storeu_si128((__m128i*)p, v);
+}
+
+/** Positive part of (hi - lo) as floats.*/
+inline __m128 Extent(__m128i lo, __m128i hi)
+{
+    return _mm_cvtepi32_ps(Max32(_mm_sub_epi32(hi, lo), _mm_setzero_si128()));
+}
+
+inline void StoreMask(uint8_t* out, __m128i mask)
+{
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(mask));
+    out[0] = bits & 1;
+    out[1] = (bits >> 1) & 1;
+    out[2] = (bits >> 2) & 1;
+    out[3] = (bits >> 3) & 1;
+}
+#endif
+
+/** The other operand: a batch, element by element.*/
+struct BatchOperand
+{
+    explicit BatchOperand(const MRegionBatch& o) : l(o.l.data()), b(o.b.data()), r(o.r.data()), t(o.t.data()) { }
+
+    int left(size_t i) const {return l[i];}
+    int bottom(size_t i) const {return b[i];}
+    int right(size_t i) const {return r[i];}
+    int top(size_t i) const {return t[i];}
+#ifdef __SSE2__
+    Quad quad(size_t i) const {return Quad{Load(l + i), Load(b + i), Load(r + i), Load(t + i)};}
+#endif
+
+    const int *l, *b, *r, *t;
+};
+
+/** The other operand: one region for all the elements.*/
+struct RegionOperand
+{
+    explicit RegionOperand(const MRegion& o) : l(o.left()), b(o.bottom()), r(o.right()), t(o.top()) { }
+
+    int left(size_t) const {return l;}
+    int bottom(size_t) const {return b;}
+    int right(size_t) const {return r;}
+    int top(size_t) const {return t;}
+#ifdef __SSE2__
+    Quad quad(size_t) const {return Quad{_mm_set1_epi32(l), _mm_set1_epi32(b), _mm_set1_epi32(r), _mm_set1_epi32(t)};}
+#endif
+
+    int l, b, r, t;
+};
+
+template<class Operand>
+void Intersect(const MRegionBatch& a, const Operand& o, MRegionBatch& out)
+{
+    const size_t n = a.size();
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= n; i += 4)
+    {
+        Quad q = o.quad(i);
+        __m128i l = Max32(Load(&a.l[i]), q.l);
+        __m128i b = Max32(Load(&a.b[i]), q.b);
+        __m128i r = Min32(Load(&a.r[i]), q.r);
+        __m128i t = Min32(Load(&a.t[i]), q.t);
+        Store(&out.l[i], l);
+        Store(&out.b[i], b);
+        Store(&out.r[i], Max32(r, l));
+        Store(&out.t[i], Max32(t, b));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        int l = std::max(a.l[i], o.left(i));
+        int b = std::max(a.b[i], o.bottom(i));
+        int r = std::min(a.r[i], o.right(i));
+        int t = std::min(a.t[i], o.top(i));
+        out.l[i] = l;
+        out.b[i] = b;
+        out.r[i] = std::max(r, l);
+        out.t[i] = std::max(t, b);
+    }
+}
+
+template<class Operand>
+void Unite(const MRegionBatch& a, const Operand& o, MRegionBatch& out)
+{
+    const size_t n = a.size();
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= n; i += 4)
+    {
+        Quad q = o.quad(i);
+        Store(&out.l[i], Min32(Load(&a.l[i]), q.l));
+        Store(&out.b[i], Min32(Load(&a.b[i]), q.b));
+        Store(&out.r[i], Max32(Load(&a.r[i]), q.r));
+        Store(&out.t[i], Max32(Load(&a.t[i]), q.t));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        out.l[i] = std::min(a.l[i], o.left(i));
+        out.b[i] = std::min(a.b[i], o.bottom(i));
+        out.r[i] = std::max(a.r[i], o.right(i));
+        out.t[i] = std::max(a.t[i], o.top(i));
+    }
+}
+
+template<class Operand>
+void IoU(const MRegionBatch& a, const Operand& o, float* out)
+{
+    const size_t n = a.size();
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= n; i += 4)
+    {
+        Quad q = o.quad(i);
+        __m128i al = Load(&a.l[i]), ab = Load(&a.b[i]), ar = Load(&a.r[i]), at = Load(&a.t[i]);
+        __m128 inter = _mm_mul_ps(Extent(Max32(al, q.l), Min32(ar, q.r)),
+                                  Extent(Max32(ab, q.b), Min32(at, q.t)));
+        __m128 area_a = _mm_mul_ps(Extent(al, ar), Extent(ab, at));
+        __m128 area_o = _mm_mul_ps(Extent(q.l, q.r), Extent(q.b, q.t));
+        __m128 uni = _mm_max_ps(_mm_sub_ps(_mm_add_ps(area_a, area_o), inter), one);
+        _mm_storeu_ps(out + i, _mm_div_ps(inter, uni));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        float iw = (float)std::max(0, std::min(a.r[i], o.right(i)) - std::max(a.l[i], o.left(i)));
+        float ih = (float)std::max(0, std::min(a.t[i], o.top(i)) - std::max(a.b[i], o.bottom(i)));
+        float inter = iw * ih;
+        float area_a = (float)std::max(0, a.r[i] - a.l[i]) * (float)std::max(0, a.t[i] - a.b[i]);
+        float area_o = (float)std::max(0, o.right(i) - o.left(i)) * (float)std::max(0, o.top(i) - o.bottom(i));
+        out[i] = inter / std::max(area_a + area_o - inter, 1.0f);
+    }
+}
+
+}//namespace
+
+//-----------------------------------------------------------------------------
+void MRegionBatch::intersect(const MRegionBatch& other, MRegionBatch& out) const
+{
+    out.resize(size());
+    Intersect(*this, BatchOperand(other), out);
+}
+
+void MRegionBatch::intersect(const MRegion& other, MRegionBatch& out) const
+{
+    out.resize(size());
+    Intersect(*this, RegionOperand(other), out);
+}
+
+void MRegionBatch::unite(const MRegionBatch& other, MRegionBatch& out) const
+{
+    out.resize(size());
+    Unite(*this, BatchOperand(other), out);
+}
+
+void MRegionBatch::unite(const MRegion& other, MRegionBatch& out) const
+{
+    out.resize(size());
+    Unite(*this, RegionOperand(other), out);
+}
+
+void MRegionBatch::iou(const MRegionBatch& other, float* out) const
+{
+    IoU(*this, BatchOperand(other), out);
+}
+
+void MRegionBatch::iou(const MRegion& other, float* out) const
+{
+    IoU(*this, RegionOperand(other), out);
+}
+
+void MRegionBatch::area(float* out) const
+{
+    const size_t n = size();
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(Extent(Load(&l[i]), Load(&r[i])), Extent(Load(&b[i]), Load(&t[i]))));
+#endif
+    for (; i < n; ++i)
+        out[i] = (float)std::max(0, r[i] - l[i]) * (float)std::max(0, t[i] - b[i]);
+}
+
+void MRegionBatch::contains(int x, int y, uint8_t* out) const
+{
+    const size_t n = size();
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i vx = _mm_set1_epi32(x), vy = _mm_set1_epi32(y);
+    for (; i + 4 <= n; i += 4)
+    {//l <= x < r, b <= y < t
+        __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(Load(&l[i]), vx), _mm_cmpgt_epi32(Load(&b[i]), vy));
+        __m128i inside = _mm_and_si128(_mm_cmpgt_epi32(Load(&r[i]), vx), _mm_cmpgt_epi32(Load(&t[i]), vy));
+        StoreMask(out + i, _mm_andnot_si128(outside, inside));
+    }
+#endif
+    for (; i < n; ++i)
+        out[i] = l[i] <= x && x < r[i] && b[i] <= y && y < t[i];
+}
+
+void MRegionBatch::contains(const MRegion& other, uint8_t* out) const
+{
+    const int ol = other.left(), ob = other.bottom(), orr = other.right(), ot = other.top();
+    const size_t n = size();
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i vl = _mm_set1_epi32(ol), vb = _mm_set1_epi32(ob);
+    const __m128i vr = _mm_set1_epi32(orr), vt = _mm_set1_epi32(ot);
+    for (; i + 4 <= n; i += 4)
+    {//l <= ol, orr <= r, b <= ob, ot <= t
+        __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(Load(&l[i]), vl), _mm_cmpgt_epi32(vr, Load(&r[i]))),
+                                       _mm_or_si128(_mm_cmpgt_epi32(Load(&b[i]), vb), _mm_cmpgt_epi32(vt, Load(&t[i]))));
+        StoreMask(out + i, _mm_xor_si128(outside, _mm_set1_epi32(-1)));
+    }
+#endif
+    for (; i < n; ++i)
+        out[i] = l[i] <= ol && orr <= r[i] && b[i] <= ob && ot <= t[i];
+}
+
+}//ZMB
@@ -0,0 +1,81 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef MREGION_BATCH_H
+#define MREGION_BATCH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "mimage.h"
+
+namespace ZMB {
+
+/** Regions as a structure of arrays: the geometry of many rectangles at once,
+ * 4 per SSE2 instruction instead of MRegion's accessors one at a time.
+ * The fields are MRegion's edges (see MakeRegion()): [l, r) x [b, t).
+ *
+ * The binary kernels go element by element against a batch of the same size
+ * or against one region; the outputs are preallocated by the caller (size() elements),
+ * an output batch may be the input one.*/
+struct MRegionBatch
+{
+    std::vector<int> l, b, r, t;//< left, bottom, right, top
+
+    MRegionBatch() { }
+    MRegionBatch(const MRegion* regions, size_t n) {assign(regions, n);}
+
+    size_t size() const {return l.size();}
+    bool empty() const {return l.empty();}
+    void clear();
+    void reserve(size_t n);
+    void resize(size_t n);
+
+    void push_back(const MRegion& reg);
+    void push_back(int left, int bottom, int right, int top);
+    void assign(const MRegion* regions, size_t n);
+
+    MRegion at(size_t i) const;
+    void to_regions(std::vector<MRegion>& out) const;
+
+    /** out[i] = this[i] & other[i], an empty intersection gets 0 width or height at it's left/bottom.*/
+    void intersect(const MRegionBatch& other, MRegionBatch& out) const;
+    void intersect(const MRegion& other, MRegionBatch& out) const;
+
+    /** out[i] = bounding box of this[i] and other[i].*/
+    void unite(const MRegionBatch& other, MRegionBatch& out) const;
+    void unite(const MRegion& other, MRegionBatch& out) const;
+
+    /** Pixels of each region, 0 for the empty ones.*/
+    void area(float* out) const;
+
+    /** out[i] = 1 if the point (x, y) is inside this[i], else 0.*/
+    void contains(int x, int y, uint8_t* out) const;
+    /** out[i] = 1 if (other) is entirely inside this[i], else 0.*/
+    void contains(const MRegion& other, uint8_t* out) const;
+
+    /** Intersection over union, the union is taken at least 1 pixel.*/
+    void iou(const MRegionBatch& other, float* out) const;
+    void iou(const MRegion& other, float* out) const;
+};
+
+}//ZMB
+
+#endif // MREGION_BATCH_H
@@ -0,0 +1,202 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef PICTURE_H
+#define PICTURE_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "mimage.h"
+
+namespace ZMB {
+
+/** Plane layouts known at compile time, the tags of Picture<Fmt>.
+ * A subsampled plane is (w >> LOG2_CHROMA_W) x (h >> LOG2_CHROMA_H), rounded up.*/
+namespace PixFmt {
+
+struct YUV420P
+{
+    static constexpr int AV_FORMAT = AV_PIX_FMT_YUV420P;
+    static constexpr int PLANES = 3;
+    static constexpr int LOG2_CHROMA_W = 1;
+    static constexpr int LOG2_CHROMA_H = 1;
+    static constexpr int bytes_per_pixel(int /*plane*/) {return 1;}
+    static constexpr bool subsampled(int plane) {return plane > 0;}
+    //the full range (JPEG) variant has the same planes
+    static constexpr bool accepts(int av_fmt) {return AV_PIX_FMT_YUV420P == av_fmt || AV_PIX_FMT_YUVJ420P == av_fmt;}
+};
+
+struct NV12
+{
+    static constexpr int AV_FORMAT = AV_PIX_FMT_NV12;
+    static constexpr int PLANES = 2;
+    static constexpr int LOG2_CHROMA_W = 1;
+    static constexpr int LOG2_CHROMA_H = 1;
+    static constexpr int bytes_per_pixel(int plane) {return 0 == plane ? 1 : 2;}//< interleaved UV
+    static constexpr bool subsampled(int plane) {return plane > 0;}
+    static constexpr bool accepts(int av_fmt) {return AV_FORMAT == av_fmt;}
+};
+
+struct GRAY8
+{
+    static constexpr int AV_FORMAT = AV_PIX_FMT_GRAY8;
+    static constexpr int PLANES = 1;
+    static constexpr int LOG2_CHROMA_W = 0;
+    static constexpr int LOG2_CHROMA_H = 0;
+    static constexpr int bytes_per_pixel(int /*plane*/) {return 1;}
+    static constexpr bool subsampled(int /*plane*/) {return false;}
+    static constexpr bool accepts(int av_fmt) {return AV_FORMAT == av_fmt;}
+};
+
+struct BGR24
+{
+    static constexpr int AV_FORMAT = AV_PIX_FMT_BGR24;
+    static constexpr int PLANES = 1;
+    static constexpr int LOG2_CHROMA_W = 0;
+    static constexpr int LOG2_CHROMA_H = 0;
+    static constexpr int bytes_per_pixel(int /*plane*/) {return 3;}
+    static constexpr bool subsampled(int /*plane*/) {return false;}
+    static constexpr bool accepts(int av_fmt) {return AV_FORMAT == av_fmt;}
+};
+
+}//PixFmt
+
+/** A typed view of a picture's planes: the format is a template parameter,
+ * so the kernels written for a Picture<Fmt> have the plane count, the subsampling
+ * and the pixel size as constants and no per-pixel format branches.
+ *
+ * The view doesn't own the pixels: it's made from a PictureHolder (view()),
+ * that must outlive it. Allocate() goes the other way, it makes an owning
+ * PictureHolder of the format.*/
+template<class Fmt>
+struct Picture
+{
+    typedef Fmt Format;
+    static constexpr int PLANES = Fmt::PLANES;
+
+    Picture() : dimension(0, 0)
+    {
+        data.fill(nullptr);
+        strides.fill(0);
+    }
+
+    explicit Picture(const PictureHolder& ph) : Picture() {view(ph);}
+
+    /** Point to (ph)'s planes, no copying.
+     * @return FALSE if (ph) is of another format, the view is empty then.*/
+    bool view(const PictureHolder& ph)
+    {
+        if (!Fmt::accepts(ph.format))
+        {
+            *this = Picture();
+            return false;
+        }
+        for (int p = 0; p < PLANES; ++p)
+        {
+            data[p] = ph.dataSlicesArray[p];
+            strides[p] = ph.stridesArray[p];
+        }
+        dimension = ph.dimension;
+        return true;
+    }
+
+    /** New picture of the format, owns it's pixels.*/
+    static PictureHolder Allocate(MSize dim) {return CreatePicture(dim, Fmt::AV_FORMAT);}
+
+    bool empty() const {return nullptr == data[0];}
+    int width() const {return dimension.width();}
+    int height() const {return dimension.height();}
+
+    static constexpr int plane_width(int plane, int w)
+    {
+        return Fmt::subsampled(plane) ? (w + (1 << Fmt::LOG2_CHROMA_W) - 1) >> Fmt::LOG2_CHROMA_W : w;
+    }
+    static constexpr int plane_height(int plane, int h)
+    {
+        return Fmt::subsampled(plane) ? (h + (1 << Fmt::LOG2_CHROMA_H) - 1) >> Fmt::LOG2_CHROMA_H : h;
+    }
+    int plane_width(int plane) const {return plane_width(plane, width());}
+    int plane_height(int plane) const {return plane_height(plane, height());}
+    /** Bytes of a plane's row that are pixels, the stride may be larger.*/
+    int row_bytes(int plane) const {return plane_width(plane) * Fmt::bytes_per_pixel(plane);}
+
+    uint8_t* row(int plane, int y) const {return data[plane] + (ptrdiff_t)y * strides[plane];}
+
+    /** The view of (w x h) pixels at (x, y), clipped. (x, y) are rounded down
+     * to the chroma grid, so the chroma planes start at the same pixels.*/
+    Picture crop(int x, int y, int w, int h) const
+    {
+        Picture res;
+        int x1 = std::min(width(), x + w);
+        int y1 = std::min(height(), y + h);
+        x = std::max(0, x) & ~((1 << Fmt::LOG2_CHROMA_W) - 1);
+        y = std::max(0, y) & ~((1 << Fmt::LOG2_CHROMA_H) - 1);
+        if (x1 <= x || y1 <= y || empty())
+            return res;
+        for (int p = 0; p < PLANES; ++p)
+        {
+            int px = Fmt::subsampled(p) ? x >> Fmt::LOG2_CHROMA_W : x;
+            int py = Fmt::subsampled(p) ? y >> Fmt::LOG2_CHROMA_H : y;
+            res.data[p] = row(p, py) + (ptrdiff_t)px * Fmt::bytes_per_pixel(p);
+            res.strides[p] = strides[p];
+        }
+        res.dimension = MSize(x1 - x, y1 - y);
+        return res;
+    }
+
+    /** For the C APIs (sws_scale()): the planes in arrays of 4, the rest are NULL.*/
+    void export_planes(const uint8_t* (&planes)[4], int (&plane_strides)[4]) const
+    {
+        for (int p = 0; p < 4; ++p)
+        {
+            planes[p] = p < PLANES ? data[p] : nullptr;
+            plane_strides[p] = p < PLANES ? strides[p] : 0;
+        }
+    }
+
+    std::array<uint8_t*, PLANES> data;
+    std::array<int, PLANES> strides;
+    MSize dimension;
+};
+
+/** Call fn(Picture<Fmt>) with the typed view of (ph): the format is switched once
+ * per picture instead of per pixel.
+ * @return FALSE if (ph)'s format isn't one of PixFmt, (fn) isn't called then.*/
+template<class Fn>
+bool VisitPicture(const PictureHolder& ph, Fn&& fn)
+{
+    if (PixFmt::YUV420P::accepts(ph.format))
+        fn(Picture<PixFmt::YUV420P>(ph));
+    else if (PixFmt::NV12::accepts(ph.format))
+        fn(Picture<PixFmt::NV12>(ph));
+    else if (PixFmt::GRAY8::accepts(ph.format))
+        fn(Picture<PixFmt::GRAY8>(ph));
+    else if (PixFmt::BGR24::accepts(ph.format))
+        fn(Picture<PixFmt::BGR24>(ph));
+    else
+        return false;
+    return true;
+}
+
+}//ZMB
+
+#endif // PICTURE_H
@@ -0,0 +1,118 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "picture_pyramid.h"
+
+namespace ZMB {
+
+/** Scaling contexts of the calling thread: a consumer usually asks for the same
+ * levels of each frame, so the contexts are reused frame to frame without locks.*/
+static constexpr int THREAD_CONTEXTS = 4;
+static thread_local SwsUniquePtr thread_contexts[THREAD_CONTEXTS];
+
+PicturePyramid::PicturePyramid(PictureSharedPtr base, std::shared_ptr<PyramidStats> stats)
+    : base_pic(base), stats(stats), levels_used(0)
+{
+
+}
+
+PictureSharedPtr PicturePyramid::scale(MSize dim, int av_fmt) const
+{
+    std::shared_ptr<PictureHolder> dst = std::make_shared<PictureHolder>(CreatePicture(dim, av_fmt));
+    if (nullptr == dst->dataSlicesArray[0])
+        return nullptr;
+    unsigned slot = ((unsigned)av_fmt * 31u + (unsigned)dim.width() * 7u + (unsigned)dim.height()) % THREAD_CONTEXTS;
+    if (!ScalePicture(*dst, *base_pic, thread_contexts[slot]))
+        return nullptr;
+    return dst;
+}
+
+PictureSharedPtr PicturePyramid::get(MSize dim, int av_fmt)
+{
+    if (nullptr == base_pic || dim.width() <= 0 || dim.height() <= 0)
+        return nullptr;
+    if (nullptr != stats)
+        stats->requests.fetch_add(1);
+    if (dim == base_pic->dimension && av_fmt == base_pic->format)
+        return base_pic;
+
+    Level* lvl = nullptr;
+    {
+        std::unique_lock<std::mutex> lk(levels_mutex);
+        for (int c = 0; c < levels_used && nullptr == lvl; ++c)
+        {
+            if (levels[c].dim == dim && levels[c].fmt == av_fmt)
+                lvl = &levels[c];
+        }
+        if (nullptr == lvl && levels_used < MAX_LEVELS)
+        {
+            lvl = &levels[levels_used++];
+            lvl->dim = dim;
+            lvl->fmt = av_fmt;
+        }
+    }
+    if (nullptr == lvl)
+    {
+        if (nullptr != stats)
+            stats->uncached.fetch_add(1);
+        return scale(dim, av_fmt);
+    }
+
+    bool made = false;
+    if (!lvl->ready.load(std::memory_order_acquire))
+    {
+        std::unique_lock<std::mutex> lk(lvl->build_mutex);
+        if (!lvl->ready.load(std::memory_order_relaxed))
+        {
+            lvl->pic = scale(dim, av_fmt);
+            lvl->ready.store(true, std::memory_order_release);
+            made = true;
+        }
+    }
+    if (nullptr != stats)
+    {
+        if (made)
+        {
+            stats->builds.fetch_add(1);
+        }
+        else
+        {
+            stats->hits.fetch_add(1);
+            stats->saved_pixels.fetch_add((uint64_t)dim.square());
+        }
+    }
+    return lvl->pic;
+}
+
+PictureSharedPtr PicturePyramid::level(int log2_div, int av_fmt)
+{
+    if (nullptr == base_pic || log2_div < 0)
+        return nullptr;
+    int round = (1 << log2_div) - 1;
+    MSize dim((base_pic->width() + round) >> log2_div, (base_pic->height() + round) >> log2_div);
+    return get(dim, av_fmt < 0 ? base_pic->format : av_fmt);
+}
+
+int PicturePyramid::size()
+{
+    std::unique_lock<std::mutex> lk(levels_mutex);
+    return levels_used;
+}
+
+}//ZMB
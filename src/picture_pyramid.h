@@ -0,0 +1,96 @@
+/*
+A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef PICTURE_PYRAMID_H
+#define PICTURE_PYRAMID_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include "mimage.h"
+
+namespace ZMB {
+
+/** Counters of the pyramids sharing them (a camera's or all of them), may be read from any thread.*/
+struct PyramidStats
+{
+    PyramidStats() { requests = 0; builds = 0; hits = 0; saved_pixels = 0; uncached = 0; }
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> builds;      //< scalings made
+    std::atomic<uint64_t> hits;        //< served from a level made before: the duplicate scalings avoided
+    std::atomic<uint64_t> saved_pixels;//< destination pixels of the hits
+    std::atomic<uint64_t> uncached;    //< scaled without caching, all the levels taken
+};
+
+/** Scaled versions of one decoded frame, shared by the frame's consumers
+ * (the detector, the tamper detection, the GUI tiles, the snapshots):
+ * a level (size and format) is scaled at most once, on it's first request,
+ * then it's shared read-only.
+ *
+ * The pyramid goes along with the frame through the pipeline
+ * and is freed with the last reference to it. Thread-safe: a level's build
+ * blocks the requests of the same level only.*/
+class PicturePyramid
+{
+public:
+    static constexpr int MAX_LEVELS = 8;
+
+    explicit PicturePyramid(PictureSharedPtr base, std::shared_ptr<PyramidStats> stats = nullptr);
+
+    PicturePyramid(const PicturePyramid&) = delete;
+    PicturePyramid& operator = (const PicturePyramid&) = delete;
+
+    const PictureSharedPtr& base() const {return base_pic;}
+
+    /** The base scaled to (dim) and converted to (av_fmt), the base itself if they match.
+     * @return NULL if there is no such conversion.*/
+    PictureSharedPtr get(MSize dim, int av_fmt);
+
+    /** The base downscaled by 2^log2_div (the size rounded up), av_fmt < 0: the base's format.*/
+    PictureSharedPtr level(int log2_div, int av_fmt = -1);
+
+    /** Levels made so far.*/
+    int size();
+
+private:
+    struct Level
+    {
+        MSize dim = MSize(0, 0);
+        int fmt = -1;
+        std::mutex build_mutex;
+        std::atomic<bool> ready{false};
+        PictureSharedPtr pic;//< written once under (build_mutex) before (ready)
+    };
+
+    PictureSharedPtr scale(MSize dim, int av_fmt) const;
+
+    PictureSharedPtr base_pic;
+    std::shared_ptr<PyramidStats> stats;
+    std::mutex levels_mutex;//< guards the levels' keys and (levels_used)
+    std::array<Level, MAX_LEVELS> levels;
+    int levels_used;
+};
+typedef std::shared_ptr<PicturePyramid> PyramidSharedPtr;
+
+}//ZMB
+
+#endif // PICTURE_PYRAMID_H
@@ -0,0 +1,342 @@
+/*A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+/** Timing of JVa::triangulate() and of a reused JVa::Workspace for 10^2..10^max points.
+ * Usage: zmbaq_delaunay_bench [max_power(2..7, default 6)]
+ * Point sets: uniform in a 1920x1080 frame; a dense freehand outline
+ * (a noisy ellipse of integer pixels, as the zones are drawn);
+ * a regular grid (collinear and cocircular points everywhere); points on a few lines.
+ * Each triangulation is checked: positive areas and the empty-circle property,
+ * the exit code is 2 if it fails.
+ * Then the zone masks: the faces inside the triangulated outlines filled by ZoneRasterizer
+ * against cv::fillPoly() for regular polygons, thin triangles, random quads and the concave
+ * zones (stars, L shapes, freehand outlines): timing, the number of differing pixels and
+ * of the failed zones, see CompareMasks().
+ */
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <chrono>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "src_videoentity/delaunay/Triangulation.h"
+#include "src_videoentity/delaunay/Predicates.h"
+#include "src_videoentity/zone_rasterizer.h"
+
+static void Uniform(int n, std::vector<JVa::Vector3>& ps)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> x(0.0, 1920.0), y(0.0, 1080.0);
+    ps.clear();
+    for (int i = 0; i < n; ++i)
+        ps.push_back(JVa::Vector3(x(rng), y(rng), 0.0));
+}
+
+static void Outline(int n, std::vector<JVa::Vector3>& ps)
+{
+    std::mt19937 rng(2);
+    std::normal_distribution<double> jitter(0.0, 2.0);
+    ps.clear();
+    for (int i = 0; i < n; ++i)
+    {
+        double a = 2.0 * M_PI * i / n;
+        ps.push_back(JVa::Vector3(std::round(960.0 + 800.0 * std::cos(a) + jitter(rng)),
+                                  std::round(540.0 + 450.0 * std::sin(a) + jitter(rng)), 0.0));
+    }
+}
+
+static void Grid(int n, std::vector<JVa::Vector3>& ps)
+{
+    int side = (int)std::ceil(std::sqrt((double)n));
+    ps.clear();
+    for (int i = 0; i < n; ++i)
+        ps.push_back(JVa::Vector3(i % side, i / side, 0.0));
+}
+
+/** Points on a few long lines: many of them land exactly on the edges.*/
+static void Lines(int n, std::vector<JVa::Vector3>& ps)
+{
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<int> t(0, 999), line(0, 3);
+    ps.clear();
+    for (int i = 0; i < n; ++i)
+    {
+        int k = t(rng);
+        switch (line(rng))
+        {
+        case 0: ps.push_back(JVa::Vector3(k, 0.0, 0.0)); break;
+        case 1: ps.push_back(JVa::Vector3(k, k, 0.0)); break;
+        case 2: ps.push_back(JVa::Vector3(k, 2 * k, 0.0)); break;
+        default: ps.push_back(JVa::Vector3(999 - k, k, 0.0)); break;
+        }
+    }
+}
+
+/** Triangles of zero or negative area and the edges failing the empty-circle test:
+ * the opposite vertex of the neighbour is strictly inside the face's circumcircle.
+ * @return the number of violations.*/
+static long CheckDelaunay(const JVa::Workspace& ws)
+{
+    long bad = 0;
+    int v[3], e[3], w[3], g[3];
+    auto at = [&ws](int i, double* p) { p[0] = ws.x[i]; p[1] = ws.y[i]; };
+    double a[2], b[2], c[2], d[2];
+    for (int f = 0; f < ws.faces_used; ++f)
+    {
+        if (ws.face_edge[f] < 0)
+            continue;
+        ws.face_ring(f, v, e);
+        at(v[0], a); at(v[1], b); at(v[2], c);
+        if (JVa::orient2d(a, b, c) <= 0)
+            ++bad;
+        for (int i = 0; i < 3; ++i)
+        {
+            int nb = (ws.fL[e[i]] == f) ? ws.fR[e[i]] : ws.fL[e[i]];
+            if (nb < 0)
+                continue;
+            ws.face_ring(nb, w, g);
+            int apex = (w[0] != v[i] && w[0] != v[(i + 1) % 3]) ? w[0]
+                     : (w[1] != v[i] && w[1] != v[(i + 1) % 3]) ? w[1] : w[2];
+            at(apex, d);
+            if (JVa::incircle(a, b, c, d) > 0)
+                ++bad;
+        }
+    }
+    return bad;
+}
+
+/** Zone shapes of the mask comparison: the integer vertices, in any order.*/
+static void RegularZone(std::mt19937& rng, int w, int h, int vertices, std::vector<glm::ivec2>& zone)
+{
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    double cx = w * (0.2 + 0.6 * u(rng)), cy = h * (0.2 + 0.6 * u(rng));
+    double rx = w * (0.05 + 0.25 * u(rng)), ry = h * (0.05 + 0.25 * u(rng));
+    zone.clear();
+    for (int i = 0; i < vertices; ++i)
+    {
+        double a = 2.0 * M_PI * i / vertices;
+        glm::ivec2 v((int)std::round(cx + rx * std::cos(a)), (int)std::round(cy + ry * std::sin(a)));
+        if (zone.empty() || zone.back() != v)
+            zone.push_back(v);
+    }
+}
+
+/** A long edge across the frame and the third vertex 1..3 px off its middle.*/
+static void ThinTriangle(std::mt19937& rng, int w, int h, int, std::vector<glm::ivec2>& zone)
+{
+    std::uniform_int_distribution<int> x(0, w - 1), y(0, h - 1), off(1, 3);
+    glm::ivec2 a(x(rng), y(rng)), b(x(rng), y(rng));
+    glm::ivec2 d(b.y - a.y, a.x - b.x);//normal
+    double len = std::max(1.0, std::sqrt((double)d.x * d.x + (double)d.y * d.y));
+    int o = off(rng);
+    glm::ivec2 c((a.x + b.x) / 2 + (int)std::round(o * d.x / len), (a.y + b.y) / 2 + (int)std::round(o * d.y / len));
+    zone.assign({a, b, c});
+}
+
+/** 4 vertices anywhere in the frame, in the order of their angles around the centre:
+ * a simple quad, often concave.*/
+static void RandomQuad(std::mt19937& rng, int w, int h, int, std::vector<glm::ivec2>& zone)
+{
+    std::uniform_int_distribution<int> x(0, w - 1), y(0, h - 1);
+    zone.clear();
+    double cx = 0.0, cy = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        zone.push_back(glm::ivec2(x(rng), y(rng)));
+        cx += zone.back().x / 4.0;
+        cy += zone.back().y / 4.0;
+    }
+    std::sort(zone.begin(), zone.end(), [cx, cy](const glm::ivec2& a, const glm::ivec2& b)
+    {
+        return std::atan2(a.y - cy, a.x - cx) < std::atan2(b.y - cy, b.x - cx);
+    });
+}
+
+/** A star: the vertices alternate between the outer and the inner radius, concave.*/
+static void StarZone(std::mt19937& rng, int w, int h, int vertices, std::vector<glm::ivec2>& zone)
+{
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    double cx = w * (0.3 + 0.4 * u(rng)), cy = h * (0.3 + 0.4 * u(rng));
+    double r = std::min(w, h) * (0.1 + 0.15 * u(rng));
+    zone.clear();
+    for (int i = 0; i < vertices; ++i)
+    {
+        double a = 2.0 * M_PI * i / vertices;
+        double ri = (i & 1) ? r * 0.4 : r;
+        glm::ivec2 v((int)std::round(cx + ri * std::cos(a)), (int)std::round(cy + ri * std::sin(a)));
+        if (zone.empty() || zone.back() != v)
+            zone.push_back(v);
+    }
+}
+
+/** An L around a doorway: the corner cut out, the vertices along the edges collinear.*/
+static void LZone(std::mt19937& rng, int w, int h, int vertices, std::vector<glm::ivec2>& zone)
+{
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    int x0 = (int)(w * 0.1 * u(rng)), y0 = (int)(h * 0.1 * u(rng));
+    int x1 = x0 + (int)(w * (0.4 + 0.4 * u(rng))), y1 = y0 + (int)(h * (0.4 + 0.4 * u(rng)));
+    int xm = (x0 + x1) / 2, ym = (y0 + y1) / 2;
+    const glm::ivec2 corners[6] = {{x0, y0}, {x1, y0}, {x1, ym}, {xm, ym}, {xm, y1}, {x0, y1}};
+    int per_edge = std::max(1, vertices / 6);
+    zone.clear();
+    for (int i = 0; i < 6; ++i)
+    {
+        const glm::ivec2& a = corners[i];
+        const glm::ivec2& b = corners[(i + 1) % 6];
+        for (int k = 0; k < per_edge; ++k)
+            zone.push_back(glm::ivec2(a.x + (b.x - a.x) * k / per_edge, a.y + (b.y - a.y) * k / per_edge));
+    }
+}
+
+/** A freehand outline: an ellipse of integer pixels with a noisy radius,
+ * may touch or cross itself where the vertices are dense.*/
+static void FreehandZone(std::mt19937& rng, int w, int h, int vertices, std::vector<glm::ivec2>& zone)
+{
+    std::normal_distribution<double> jitter(1.0, 0.01);
+    zone.clear();
+    for (int i = 0; i < vertices; ++i)
+    {
+        double a = 2.0 * M_PI * i / vertices, r = 0.4 * jitter(rng);
+        glm::ivec2 v((int)std::round(w * (0.5 + r * std::cos(a))),
+                     (int)std::round(h * (0.5 + r * std::sin(a))));
+        if (zone.empty() || zone.back() != v)
+            zone.push_back(v);
+    }
+}
+
+/** ZoneRasterizer::FillFaces() of JVa::Workspace::triangulate_outline() against cv::fillPoly()
+ * of the same outline in a (w)x(h) frame. The edge pixels' ownership differs: a zone fails
+ * if a pixel farther than a pixel from the outline differs. The edges skipped at
+ * the self-intersections are counted.
+ * @return the number of the failures.*/
+static long CompareMasks(const char* name, int w, int h, int vertices,
+                         void (*make)(std::mt19937&, int, int, int, std::vector<glm::ivec2>&))
+{
+    std::mt19937 rng(3);
+    const int ZONES = 100;
+    cv::Mat ours(h, w, CV_8UC1), ref(h, w, CV_8UC1), band(h, w, CV_8UC1);
+    JVa::Workspace ws;
+    std::vector<glm::ivec2> zone;
+    std::vector<cv::Point> poly;
+    double ours_us = 0.0, ref_us = 0.0;
+    long diff = 0, area = 0, failed = 0, skipped = 0;
+    for (int z = 0; z < ZONES; ++z)
+    {
+        make(rng, w, h, vertices, zone);
+        poly.clear();
+        for (const glm::ivec2& v : zone)
+            poly.push_back(cv::Point(v.x, v.y));
+
+        ours.setTo(0);
+        auto start = std::chrono::steady_clock::now();
+        skipped += ws.triangulate_outline(zone.data(), (int)zone.size());
+        ZMBEntities::ZoneRasterizer::FillFaces(ours, ws, 1.0f, 1.0f, 255);
+        ours_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        ref.setTo(0);
+        start = std::chrono::steady_clock::now();
+        const cv::Point* pts = poly.data();
+        int npts = (int)poly.size();
+        cv::fillPoly(ref, &pts, &npts, 1, cv::Scalar(255));
+        ref_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        cv::Mat d;
+        cv::compare(ours, ref, d, cv::CMP_NE);
+        diff += cv::countNonZero(d);
+        area += cv::countNonZero(ref);
+
+        band.setTo(0);
+        cv::polylines(band, &pts, &npts, 1, true, cv::Scalar(255), 3);
+        cv::compare(band, 0, band, cv::CMP_EQ);
+        cv::bitwise_and(d, band, d);
+        int far = cv::countNonZero(d);
+        if (far > 0)
+        {
+            std::cerr << name << " zone " << z << ": " << far << " pixels off the outline differ\n";
+            ++failed;
+        }
+    }
+    printf("%-8s %5dx%-5d %8d %12.1f %12.1f %10ld %9.3f%% %8ld %8ld\n", name, w, h, vertices,
+           ours_us / ZONES, ref_us / ZONES, diff / ZONES, area > 0 ? 100.0 * diff / area : 0.0,
+           skipped, failed);
+    return failed;
+}
+
+int main(int argc, char** argv)
+{
+    int max_power = argc > 1 ? std::atoi(argv[1]) : 6;
+    if (max_power < 2 || max_power > 7)
+    {
+        std::cerr << "Usage: zmbaq_delaunay_bench [max_power(2..7)]\n";
+        return 1;
+    }
+
+    struct Set { const char* name; void (*make)(int, std::vector<JVa::Vector3>&); };
+    const Set sets[] = {{"uniform", Uniform}, {"outline", Outline}, {"grid", Grid}, {"lines", Lines}};
+
+    std::vector<JVa::Vector3> ps;
+    std::vector<glm::vec2> pts;
+    JVa::Workspace ws;
+    long violations = 0;
+    printf("%-8s %10s %12s %12s %12s %10s\n", "set", "points", "total ms", "ns/point", "reused ms", "not DT");
+    for (const Set& s : sets)
+    {
+        for (int p = 2; p <= max_power; ++p)
+        {
+            int n = (int)std::pow(10.0, p);
+            s.make(n, ps);
+            auto start = std::chrono::steady_clock::now();
+            std::shared_ptr<JVa::Result> res = JVa::triangulate(ps.data(), n);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            //the zone editor's case: same workspace, the capacity is already there
+            pts.clear();
+            for (const JVa::Vector3& v : ps)
+                pts.push_back(glm::vec2((float)v.x, (float)v.y));
+            ws.triangulate(pts.data(), n);
+            start = std::chrono::steady_clock::now();
+            ws.triangulate(pts.data(), n);
+            double reused_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            long bad = CheckDelaunay(ws);
+            violations += bad;
+            printf("%-8s %10d %12.2f %12.1f %12.2f %10ld\n", s.name, n, ms, ms * 1e6 / n, reused_ms, bad);
+        }
+    }
+
+    printf("\n%-8s %-11s %8s %12s %12s %10s %10s %8s %8s\n", "zones", "mask", "vertices",
+           "ours us", "fillPoly us", "diff px", "diff", "skipped", "failed");
+    long mask_failures = 0;
+    mask_failures += CompareMasks("regular", 240, 135, 8, RegularZone);
+    mask_failures += CompareMasks("regular", 1920, 1080, 64, RegularZone);
+    mask_failures += CompareMasks("thin", 1920, 1080, 3, ThinTriangle);
+    mask_failures += CompareMasks("quad", 240, 135, 4, RandomQuad);
+    mask_failures += CompareMasks("quad", 1920, 1080, 4, RandomQuad);
+    mask_failures += CompareMasks("star", 240, 135, 16, StarZone);
+    mask_failures += CompareMasks("star", 1920, 1080, 64, StarZone);
+    mask_failures += CompareMasks("L", 240, 135, 24, LZone);
+    mask_failures += CompareMasks("freehand", 1920, 1080, 1000, FreehandZone);
+    if (violations > 0 || mask_failures > 0)
+    {
+        std::cerr << "FAILED: " << violations << " faces or edges are not Delaunay, "
+                  << mask_failures << " zone masks differ from cv::fillPoly()\n";
+        return 2;
+    }
+    return 0;
+}
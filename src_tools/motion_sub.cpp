@@ -0,0 +1,108 @@
+/*A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov. 
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+/** Local subscriber of the motion events bus, for testing.
+ * Usage: zmbaq_motion_sub [endpoint] [topic]
+ * Default endpoint is tcp://127.0.0.1:5570
+ */
+#include <zmq.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "src_videoentity/motion_event_bus.h"
+
+using namespace ZMBEntities;
+
+static const char* StateName(uint8_t state)
+{
+    static const char* names[] = {"Null", "Invoked", "Moving", "Calmed"};
+    return state < 4 ? names[state] : "?";
+}
+
+static const char* TypeName(uint8_t type)
+{
+    static const char* names[] = {"Uncertain", "Blick", "Motion"};
+    static const char* tamper_names[] = {"Covered", "Defocused", "Moved"};
+    if (type >= MotionEvent::TAMPER_BASE && type < MotionEvent::TAMPER_BASE + 3)
+        return tamper_names[type - MotionEvent::TAMPER_BASE];
+    return type < 3 ? names[type] : "?";
+}
+
+int main(int argc, char** argv)
+{
+    std::string endpoint = argc > 1 ? argv[1] : "tcp://127.0.0.1:5570";
+    std::string topic = argc > 2 ? argv[2] : MotionEventBusParams().topic;
+
+    void* ctx = zmq_ctx_new();
+    void* sock = zmq_socket(ctx, ZMQ_SUB);
+    zmq_setsockopt(sock, ZMQ_SUBSCRIBE, topic.data(), topic.size());
+    if (0 != zmq_connect(sock, endpoint.c_str()))
+    {
+        std::cerr << "Can't connect to " << endpoint << ": " << zmq_strerror(zmq_errno()) << "\n";
+        return 1;
+    }
+    std::cerr << "Listening " << endpoint << " topic \"" << topic << "\"\n";
+
+    MotionEventBatchHeader header;
+    std::vector<MotionEvent> events;
+    uint32_t expected_seq = 0;
+    bool first = true;
+    uint64_t lost = 0;
+
+    while (true)
+    {
+        zmq_msg_t part;
+        zmq_msg_init(&part);
+        if (0 > zmq_msg_recv(&part, sock, 0))
+            break;
+
+        //skip the topic frame, the payload is the last part
+        if (zmq_msg_more(&part))
+        {
+            zmq_msg_close(&part);
+            continue;
+        }
+
+        bool ok = ParseMotionEventBatch(zmq_msg_data(&part), zmq_msg_size(&part), header, events);
+        zmq_msg_close(&part);
+        if (!ok)
+        {
+            std::cerr << "Malformed batch\n";
+            continue;
+        }
+
+        if (!first && header.sequence != expected_seq)
+        {
+            lost += header.sequence - expected_seq;
+            std::cerr << "Lost batches: " << lost << "\n";
+        }
+        first = false;
+        expected_seq = header.sequence + 1;
+
+        for (const MotionEvent& ev : events)
+        {
+            printf("%lld cam=%u zone=%u %s %s ratio=%.4f\n",
+                   (long long)ev.ts_usec, ev.camera, ev.zone,
+                   TypeName(ev.type), StateName(ev.state), ev.pixel_ratio);
+        }
+        fflush(stdout);
+    }
+
+    zmq_close(sock);
+    zmq_ctx_term(ctx);
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov. 
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+/** Offline motion analysis of recorded files, faster than real time.
+ * Usage: zmbaq_scan [-j workers] [-o output_dir] [-t threshold] [-d deviation_ratio]
+ *                   [-c decoding_cores] [-T decoder_threads] [-p full|analysis|mv|all] files...
+ * Writes <output_dir>/<file>.timeline.tsv for each of the files.
+ * Reports the decoder's CPU time (worker threads included) per stream and per profile,
+ * "-p all" scans the files with each of the profiles and compares them with "full".
+ */
+#include <iostream>
+#include <string>
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+#include "src/minor/timingutils.h"
+#include "src_videoentity/offline_scanner.h"
+#include "../external/avcpp/src/av.h"
+#include "../external/avcpp/src/avutils.h"
+
+using namespace ZMBEntities;
+
+static void Usage()
+{
+    std::cerr << "Usage: zmbaq_scan [-j workers] [-o output_dir] [-t threshold] [-d deviation_ratio]"
+                 " [-c decoding_cores] [-T decoder_threads] [-p full|analysis|mv|all] files...\n";
+}
+
+/** Decoders' totals of one profile's run.*/
+struct ProfileTotals
+{
+    DecodeProfile profile = DecodeProfile::Full;
+    size_t streams = 0;
+    size_t failed = 0;
+    uint64_t frames = 0;
+    uint64_t cpu_usec = 0;
+    uint64_t wall_usec = 0;
+    double elapsed_sec = 0.0;
+
+    double cpu_per_stream_sec() const {return streams > 0 ? cpu_usec / 1e6 / streams : 0.0;}
+};
+
+static ProfileTotals ScanFiles(OfflineScanParams params, DecodeProfile profile, const std::vector<std::string>& files)
+{
+    params.decode_profile = profile;
+    OfflineScanner scanner(params);
+    for (const std::string& f : files)
+        scanner.add(f);
+
+    ProfileTotals totals;
+    totals.profile = profile;
+    std::mutex out_mutex;
+    scanner.onFileDone = [&out_mutex, &totals](const OfflineFileScan& scan, bool ok)
+    {
+        std::unique_lock<std::mutex> lk(out_mutex);
+        const DecoderStats& dec(scan.decoder_stats());
+        ++totals.streams;
+        totals.frames += dec.frames();
+        totals.cpu_usec += dec.cpu_usec();
+        totals.wall_usec += dec.wall_usec();
+        std::cout << (ok ? "done " : "FAILED ") << scan.path()
+                  << " profile: " << DecodeProfileName(totals.profile)
+                  << " frames: " << scan.frames()
+                  << " events: " << scan.timeline().size()
+                  << " decoder: " << dec.to_string()
+                  << " -> " << scan.timeline_path() << std::endl;
+    };
+
+    TimingUtils::LapTimer timer;
+    totals.failed = scanner.run();
+    totals.elapsed_sec = timer.elapsed();
+    return totals;
+}
+
+int main(int argc, char** argv)
+{
+    OfflineScanParams params;
+    std::vector<std::string> files;
+    std::vector<DecodeProfile> profiles(1, params.decode_profile);
+
+    for (int c = 1; c < argc; ++c)
+    {
+        std::string arg(argv[c]);
+        bool has_value = c + 1 < argc;
+        if ("-j" == arg && has_value)
+            params.workers = (unsigned)std::atoi(argv[++c]);
+        else if ("-o" == arg && has_value)
+            params.output_dir = argv[++c];
+        else if ("-t" == arg && has_value)
+            params.bgs_params["threshold"] = std::atof(argv[++c]);
+        else if ("-d" == arg && has_value)
+            params.bgs_params["deviation_ratio"] = std::atof(argv[++c]);
+        else if ("-c" == arg && has_value)
+            DecoderCoreBudget::instance().set_budget(std::atoi(argv[++c]));
+        else if ("-T" == arg && has_value)
+            params.decoder_threads = std::atoi(argv[++c]);
+        else if ("-p" == arg && has_value)
+        {
+            std::string p(argv[++c]);
+            profiles.clear();
+            if ("full" == p || "all" == p)
+                profiles.push_back(DecodeProfile::Full);
+            if ("analysis" == p || "all" == p)
+                profiles.push_back(DecodeProfile::Analysis);
+            if ("mv" == p || "all" == p)
+                profiles.push_back(DecodeProfile::MotionVectors);
+            if (profiles.empty())
+            {
+                std::cerr << "Unknown profile: " << p << "\n";
+                Usage();
+                return 1;
+            }
+        }
+        else if ("-h" == arg || '-' == arg[0])
+        {
+            Usage();
+            return 1;
+        }
+        else
+            files.push_back(arg);
+    }
+    if (files.empty())
+    {
+        Usage();
+        return 1;
+    }
+
+    av::init();
+    av::setFFmpegLoggingLevel(AV_LOG_ERROR);
+
+    std::vector<ProfileTotals> runs;
+    for (DecodeProfile profile : profiles)
+        runs.push_back(ScanFiles(params, profile, files));
+
+    size_t failed = 0;
+    const ProfileTotals* full = nullptr;
+    for (const ProfileTotals& r : runs)
+    {
+        if (DecodeProfile::Full == r.profile)
+            full = &r;
+    }
+    for (const ProfileTotals& r : runs)
+    {
+        failed += r.failed;
+        std::cout << DecodeProfileName(r.profile) << ": " << r.streams << " files in " << r.elapsed_sec << " s"
+                  << ", decoder cpu: " << r.cpu_usec / 1e6 << " s, per stream: " << r.cpu_per_stream_sec() << " s"
+                  << ", cpu us/frame: " << (r.frames > 0 ? r.cpu_usec / r.frames : 0)
+                  << ", wall us/frame: " << (r.frames > 0 ? r.wall_usec / r.frames : 0);
+        if (nullptr != full && &r != full && full->cpu_per_stream_sec() > 0.0)
+            std::cout << ", cpu saved per stream: "
+                      << 100.0 * (1.0 - r.cpu_per_stream_sec() / full->cpu_per_stream_sec()) << "%";
+        std::cout << ", failed: " << r.failed << std::endl;
+    }
+    return failed > 0 ? 2 : 0;
+}
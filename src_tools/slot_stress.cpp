@@ -0,0 +1,97 @@
+/*A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+/** Stress of ZMB::LatestSlot: one writer publishes frames as fast as it can,
+ * the readers grab the newest ones, each frame's payload is verified
+ * and each reader must see the sequence numbers never going back.
+ * Usage: zmbaq_slot_stress [readers(default 4)] [frames(default 1000000)]
+ * Build with -DWITH_THREAD_SANITIZER=ON to check the races.
+ */
+#include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "src/minor/latest_slot.hpp"
+
+struct Frame
+{
+    static constexpr int PAYLOAD = 64;
+
+    explicit Frame(uint64_t seq) : seq(seq)
+    {
+        for (int c = 0; c < PAYLOAD; ++c)
+            payload[c] = seq * 31 + c;
+    }
+
+    bool valid() const
+    {
+        for (int c = 0; c < PAYLOAD; ++c)
+        {
+            if (payload[c] != seq * 31 + c)
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t seq;
+    uint64_t payload[PAYLOAD];
+};
+
+int main(int argc, char** argv)
+{
+    int readers = argc > 1 ? std::max(1, std::atoi(argv[1])) : 4;
+    uint64_t frames = argc > 2 ? (uint64_t)std::max(1, std::atoi(argv[2])) : 1000000;
+
+    ZMB::LatestSlot<Frame> slot;
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> reads(0), errors(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r)
+    {
+        threads.emplace_back([&]()
+        {
+            uint64_t last = 0, cnt = 0;
+            while (!done.load(std::memory_order_relaxed))
+            {
+                ZMB::LatestSlot<Frame>::ValuePtr f = slot.get();
+                if (nullptr == f)
+                    continue;
+                if (f->seq < last || !f->valid())
+                    errors.fetch_add(1);
+                last = f->seq;
+                ++cnt;
+            }
+            reads.fetch_add(cnt);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t seq = 1; seq <= frames; ++seq)
+        slot.publish(std::make_shared<const Frame>(seq));
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    done.store(true);
+    for (std::thread& t : threads)
+        t.join();
+
+    std::cout << "published " << frames << " in " << sec << " s ("
+              << (sec > 0.0 ? frames / sec : 0.0) << "/s), dropped " << slot.dropped()
+              << ", reads " << reads.load() << ", errors " << errors.load() << std::endl;
+    return 0 == errors.load() ? 0 : 1;
+}
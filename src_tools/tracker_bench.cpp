@@ -0,0 +1,181 @@
+/*A video surveillance software with support of H264 video sources.
+Copyright (C) 2015 Bogdan Maslowsky, Alexander Sorvilov.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+/** Timing of ZMBEntities::BlobTracker::update() on synthetic scenes.
+ * Usage: zmbaq_tracker_bench [objects(default 100)] [frames(default 20000)]
+ * The objects walk in a 1920x1080 frame at 25 fps, each one inside it's own cell of a grid,
+ * so they never overlap and each must keep it's track ID; the boxes are jittered, 2% of the
+ * detections are missed and a few one-frame blicks are added. Prints the track updates
+ * (objects x frames) per second of one core, the exit code is 2 if an object's ID has changed.
+ */
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <chrono>
+#include "src_videoentity/blob_tracker.h"
+
+using namespace ZMBEntities;
+
+struct Object
+{
+    float x, y;     //< box center
+    float vx, vy;   //< pixels per second
+    float x0, y0, x1, y1;//< the cell the center stays in
+    uint32_t track_id;
+    int blob;       //< index in the frame's blobs, -1: not detected on this frame
+};
+
+static const int FRAME_W = 1920;
+static const int FRAME_H = 1080;
+static const int BOX_W = 40;
+static const int BOX_H = 30;
+
+static std::vector<Object> MakeScene(int n, std::mt19937& rng)
+{
+    int cols = (int)std::ceil(std::sqrt(n * (double)FRAME_W / FRAME_H));
+    int rows = (n + cols - 1) / cols;
+    float cw = (float)FRAME_W / cols;
+    float ch = (float)FRAME_H / rows;
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    std::vector<Object> res;
+    for (int i = 0; i < n; ++i)
+    {
+        Object o;
+        o.x0 = (i % cols) * cw + BOX_W * 0.5f;
+        o.x1 = (i % cols + 1) * cw - BOX_W * 0.5f;
+        o.y0 = (i / cols) * ch + BOX_H * 0.5f;
+        o.y1 = (i / cols + 1) * ch - BOX_H * 0.5f;
+        o.x = o.x0 + u(rng) * std::max(0.0f, o.x1 - o.x0);
+        o.y = o.y0 + u(rng) * std::max(0.0f, o.y1 - o.y0);
+        float a = 2.0f * (float)M_PI * u(rng);
+        float speed = 40.0f + 80.0f * u(rng);
+        o.vx = speed * std::cos(a);
+        o.vy = speed * std::sin(a);
+        o.track_id = 0;
+        o.blob = -1;
+        res.push_back(o);
+    }
+    return res;
+}
+
+/** Walk with a slowly turning heading, steered back to the cell's center near it's walls:
+ * the way people and cars move, no bounces the constant velocity model can't follow.*/
+static void Move(Object& o, float dt, std::mt19937& rng)
+{
+    std::normal_distribution<float> turn(0.0f, 0.05f);
+    float speed = std::sqrt(o.vx * o.vx + o.vy * o.vy);
+    float a = std::atan2(o.vy, o.vx) + turn(rng);
+    bool near_wall = o.x < o.x0 + 10.0f || o.x > o.x1 - 10.0f || o.y < o.y0 + 10.0f || o.y > o.y1 - 10.0f;
+    if (near_wall)
+    {
+        float to_center = std::atan2(0.5f * (o.y0 + o.y1) - o.y, 0.5f * (o.x0 + o.x1) - o.x);
+        float d = std::remainder(to_center - a, 2.0f * (float)M_PI);
+        a += std::max(-0.3f, std::min(0.3f, d));
+    }
+    o.vx = speed * std::cos(a);
+    o.vy = speed * std::sin(a);
+    o.x = std::min(std::max(o.x + o.vx * dt, o.x0), o.x1);
+    o.y = std::min(std::max(o.y + o.vy * dt, o.y0), o.y1);
+}
+
+int main(int argc, char** argv)
+{
+    int objects = argc > 1 ? std::atoi(argv[1]) : 100;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 20000;
+    if (objects < 1 || frames < 1)
+    {
+        std::cerr << "Usage: zmbaq_tracker_bench [objects(default 100)] [frames(default 20000)]\n";
+        return 1;
+    }
+
+    std::mt19937 rng(1);
+    std::vector<Object> scene = MakeScene(objects, rng);
+    std::normal_distribution<float> jitter(0.0f, 1.0f);
+    std::uniform_int_distribution<int> blick_x(0, FRAME_W - 20), blick_y(0, FRAME_H - 20), percent(0, 99);
+
+    BlobTrackerParams params;
+    params.max_tracks = std::max<size_t>(params.max_tracks, (size_t)objects * 2);
+    BlobTracker tracker(params);
+    std::vector<MotionBlob> blobs;
+    const int64_t frame_usec = 40000;
+    const float dt = frame_usec / 1e6f;
+
+    long switches = 0;
+    long started = 0;
+    double update_sec = 0.0;
+    for (int f = 0; f < frames; ++f)
+    {
+        blobs.clear();
+        for (Object& o : scene)
+        {
+            Move(o, dt, rng);
+            //a missed detection now and then: the track must survive it
+            o.blob = percent(rng) < 2 ? -1 : (int)blobs.size();
+            if (o.blob < 0)
+                continue;
+            MotionBlob b;
+            int w = BOX_W + (int)std::lround(jitter(rng));
+            int h = BOX_H + (int)std::lround(jitter(rng));
+            int x = (int)std::lround(o.x + jitter(rng)) - w / 2;
+            int y = (int)std::lround(o.y + jitter(rng)) - h / 2;
+            b.region = ZMB::MakeRegion(x, y, w, h);
+            b.area = w * h;
+            b.centroid = glm::vec2(o.x, o.y);
+            blobs.push_back(b);
+        }
+        if (percent(rng) < 10)
+        {//a light blick: one frame, never confirmed
+            MotionBlob b;
+            b.region = ZMB::MakeRegion(blick_x(rng), blick_y(rng), 20, 20);
+            b.area = 400;
+            blobs.push_back(b);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        tracker.update(blobs, (int64_t)f * frame_usec);
+        update_sec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (const TrackEvent& ev : tracker.events())
+        {
+            if (TrackEvent::Started == ev.kind)
+                ++started;
+        }
+        for (Object& o : scene)
+        {
+            if (o.blob < 0 || 0 == blobs[o.blob].track_id)
+                continue;
+            uint32_t id = blobs[o.blob].track_id;
+            if (0 != o.track_id && o.track_id != id)
+                ++switches;
+            o.track_id = id;
+        }
+    }
+
+    double updates = (double)objects * frames;
+    printf("%-8s %8s %12s %12s %14s %10s %10s\n", "objects", "frames", "total ms", "us/frame", "updates/s", "started", "switches");
+    printf("%-8d %8d %12.2f %12.2f %14.0f %10ld %10ld\n", objects, frames, update_sec * 1e3,
+           update_sec * 1e6 / frames, update_sec > 0.0 ? updates / update_sec : 0.0, started, switches);
+    if (switches > 0)
+    {
+        std::cerr << "FAILED: " << switches << " track IDs changed on non-overlapping objects\n";
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "bgs_snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <boost/filesystem.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ZMBEntities {
+
+BackgroundSnapshotStore::BackgroundSnapshotStore(const ZMFS::FSLocation& location)
+    : location(location), writing(false), stop(false)
+{
+    try
+    {
+        boost::filesystem::create_directories(boost::filesystem::path(location.location));
+    }
+    catch(boost::filesystem::filesystem_error& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+    }
+    writer = std::thread([this]() { run(); });
+}
+
+BackgroundSnapshotStore::~BackgroundSnapshotStore()
+{
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        stop = true;
+    }
+    cond.notify_all();
+    if (writer.joinable())
+        writer.join();
+}
+
+std::string BackgroundSnapshotStore::path(const std::string& key) const
+{
+    std::string res;
+    location.absolute_path(res, key + ".bgsnap");
+    return res;
+}
+
+uint32_t BackgroundSnapshotStore::Checksum(const uint8_t* data, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t c = 0; c < len; ++c)
+    {
+        h ^= data[c];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void BackgroundSnapshotStore::submit(const std::string& key, const BackgroundSnapshot& snapshot)
+{
+    if (snapshot.background.empty())
+        return;
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        queued[key] = snapshot;
+        latest[key] = snapshot;
+    }
+    cond.notify_all();
+}
+
+void BackgroundSnapshotStore::flush()
+{
+    std::unique_lock<std::mutex> lk(mutex);
+    cond.wait(lk, [this]() { return stop || (queued.empty() && !writing); });
+}
+
+bool BackgroundSnapshotStore::load(const std::string& key, BackgroundSnapshot& snapshot) const
+{
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        auto iter = latest.find(key);
+        if (latest.end() != iter)
+        {
+            snapshot = iter->second;
+            snapshot.background = iter->second.background.clone();
+            return true;
+        }
+    }
+    return read(path(key), snapshot);
+}
+
+void BackgroundSnapshotStore::run()
+{
+    std::unique_lock<std::mutex> lk(mutex);
+    while (true)
+    {
+        cond.wait(lk, [this]() { return stop || !queued.empty(); });
+        if (queued.empty())
+            break;//stopped and flushed
+
+        std::map<std::string, BackgroundSnapshot> batch;
+        batch.swap(queued);
+        writing = true;
+        lk.unlock();
+        for (auto& item : batch)
+        {
+            write(item.first, item.second);
+        }
+        lk.lock();
+        writing = false;
+        cond.notify_all();
+    }
+}
+
+bool BackgroundSnapshotStore::write(const std::string& key, const BackgroundSnapshot& snapshot) const
+{
+    const cv::Mat& bg(snapshot.background);
+    cv::Mat packed = bg.isContinuous() ? bg : bg.clone();
+    size_t len = packed.total() * packed.elemSize();
+
+    BackgroundSnapshotHeader hdr;
+    hdr.magic = BackgroundSnapshotHeader::MAGIC;
+    hdr.version = BackgroundSnapshotHeader::VERSION;
+    hdr.channels = (uint16_t)packed.channels();
+    hdr.width = (uint32_t)packed.cols;
+    hdr.height = (uint32_t)packed.rows;
+    hdr.frame_cnt = snapshot.frame_cnt;
+    hdr.checksum = Checksum(packed.data, len);
+    hdr.ts_usec = snapshot.ts_usec;
+
+    std::string dst = path(key);
+    std::string tmp = dst + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (nullptr == f)
+    {
+        std::cerr << "Can't write " << tmp << "\n";
+        return false;
+    }
+    bool ok = 1 == fwrite(&hdr, sizeof(hdr), 1, f)
+            && 1 == fwrite(packed.data, len, 1, f);
+    //the data must reach the disk before the rename: else a crash may leave an empty file in place
+    ok = ok && 0 == fflush(f) && 0 == fsync(fileno(f));
+    ok = (0 == fclose(f)) && ok;
+    if (!ok || 0 != std::rename(tmp.c_str(), dst.c_str()))
+    {
+        std::cerr << "Can't store the background snapshot " << dst << "\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    //the rename itself, best effort
+    int dir = ::open(boost::filesystem::path(dst).parent_path().c_str(), O_RDONLY);
+    if (dir >= 0)
+    {
+        fsync(dir);
+        ::close(dir);
+    }
+    return true;
+}
+
+bool BackgroundSnapshotStore::read(const std::string& file_path, BackgroundSnapshot& snapshot) const
+{
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (0 != fstat(fd, &st) || (size_t)st.st_size < sizeof(BackgroundSnapshotHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    size_t file_len = (size_t)st.st_size;
+    void* mem = mmap(nullptr, file_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (MAP_FAILED == mem)
+        return false;
+
+    BackgroundSnapshotHeader hdr;
+    std::memcpy(&hdr, mem, sizeof(hdr));
+    const uint8_t* pixels = (const uint8_t*)mem + sizeof(hdr);
+    size_t len = (size_t)hdr.width * hdr.height * hdr.channels;
+
+    bool ok = BackgroundSnapshotHeader::MAGIC == hdr.magic
+            && BackgroundSnapshotHeader::VERSION == hdr.version
+            && hdr.channels > 0 && hdr.channels <= 4
+            && sizeof(hdr) + len == file_len
+            && hdr.checksum == Checksum(pixels, len);
+    if (ok)
+    {
+        cv::Mat mapped((int)hdr.height, (int)hdr.width, CV_8UC(hdr.channels), (void*)pixels);
+        snapshot.background = mapped.clone();
+        snapshot.frame_cnt = hdr.frame_cnt;
+        snapshot.ts_usec = hdr.ts_usec;
+    }
+    else
+    {
+        std::cerr << "Invalid background snapshot " << file_path << "\n";
+    }
+    munmap(mem, file_len);
+    return ok;
+}
+
+}//ZMBEntities
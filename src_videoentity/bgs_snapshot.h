@@ -0,0 +1,91 @@
+#ifndef BGS_SNAPSHOT_H
+#define BGS_SNAPSHOT_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+#include "../src/fshelper.h"
+
+namespace ZMBEntities {
+
+#pragma pack(push, 1)
+/** File header of a background snapshot, followed by (height * width * channels) bytes
+ * of the background picture (rows without padding). Little-endian.*/
+struct BackgroundSnapshotHeader
+{
+    static constexpr uint32_t MAGIC = 0x47424D5A;//< "ZMBG"
+    static constexpr uint16_t VERSION = 1;
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t channels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_cnt;  //< frames the model had learnt
+    uint32_t checksum;   //< FNV-1a of the pixels
+    int64_t ts_usec;     //< stream's time of the snapshot
+};
+#pragma pack(pop)
+
+/** A background model's state that survives restarts.*/
+struct BackgroundSnapshot
+{
+    cv::Mat background;  //< CV_8UC(channels), detection resolution
+    uint32_t frame_cnt = 0;
+    int64_t ts_usec = 0;
+};
+
+/** Stores the detectors' background snapshots as "<key>.bgsnap" files in a directory.
+ * submit() only queues the picture (the latest one per key wins),
+ * a single background thread writes the files: temporary file + rename,
+ * so a crash leaves the previous snapshot intact.
+ * load() maps the file into memory, checks it and copies out the picture.
+ * The last submitted snapshots are also kept in memory, so a camera reconnecting
+ * within the same process gets the freshest one without disk IO.
+ * Thread-safe.*/
+class BackgroundSnapshotStore
+{
+public:
+    explicit BackgroundSnapshotStore(const ZMFS::FSLocation& location);
+    ~BackgroundSnapshotStore();
+
+    BackgroundSnapshotStore(const BackgroundSnapshotStore&) = delete;
+    BackgroundSnapshotStore& operator = (const BackgroundSnapshotStore&) = delete;
+
+    /** Queue the snapshot for writing, the picture is not copied: don't modify it afterwards.*/
+    void submit(const std::string& key, const BackgroundSnapshot& snapshot);
+
+    /** @return FALSE if there is no valid snapshot for the key.*/
+    bool load(const std::string& key, BackgroundSnapshot& snapshot) const;
+
+    /** Wait till the queued snapshots are written.*/
+    void flush();
+
+    /** Full path of the key's file.*/
+    std::string path(const std::string& key) const;
+
+    static uint32_t Checksum(const uint8_t* data, size_t len);
+
+private:
+    void run();
+    bool write(const std::string& key, const BackgroundSnapshot& snapshot) const;
+    bool read(const std::string& file_path, BackgroundSnapshot& snapshot) const;
+
+    ZMFS::FSLocation location;
+
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    std::map<std::string, BackgroundSnapshot> queued;
+    std::map<std::string, BackgroundSnapshot> latest;
+    bool writing;
+    bool stop;
+    std::thread writer;
+};
+
+}//ZMBEntities
+
+#endif // BGS_SNAPSHOT_H
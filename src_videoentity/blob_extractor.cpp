@@ -0,0 +1,137 @@
+#include "blob_extractor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ZMBEntities {
+
+int BlobExtractor::find(int label)
+{
+    while (parent[label] != label)
+    {//path halving
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+void BlobExtractor::unite(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+    if (a == b)
+        return;
+    //the older label is the root: keeps the trees shallow for the top-down scan
+    if (a < b)
+        parent[b] = a;
+    else
+        parent[a] = b;
+}
+
+const std::vector<MotionBlob>& BlobExtractor::extract(const uint8_t* mask, int width, int height, int stride)
+{
+    runs.clear();
+    parent.clear();
+    result.clear();
+    if (nullptr == mask || width <= 0 || height <= 0)
+        return result;
+
+    //runs overlapping with 8-connectivity touch diagonally too
+    const int reach = eight_connected ? 1 : 0;
+    size_t prev_begin = 0, prev_end = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        const uint8_t* line = mask + (size_t)y * stride;
+        size_t row_begin = runs.size();
+        size_t p = prev_begin;
+
+        int x = 0;
+        while (x < width)
+        {
+            while (x < width && 0 == line[x])
+                ++x;
+            if (x >= width)
+                break;
+            int x0 = x;
+            while (x < width && 0 != line[x])
+                ++x;
+
+            int label = (int)parent.size();
+            parent.push_back(label);
+            runs.push_back(Run{y, x0, x, label});
+
+            //previous row's runs ending before this one can't touch the next ones either
+            while (p < prev_end && runs[p].x1 + reach <= x0)
+                ++p;
+            for (size_t q = p; q < prev_end && runs[q].x0 < x + reach; ++q)
+            {
+                unite(runs[q].label, label);
+            }
+        }
+        prev_begin = row_begin;
+        prev_end = runs.size();
+    }
+
+    //accumulate per root
+    root_to_blob.assign(parent.size(), -1);
+    accums.clear();
+    for (const Run& r : runs)
+    {
+        int root = find(r.label);
+        int idx = root_to_blob[root];
+        if (idx < 0)
+        {
+            idx = root_to_blob[root] = (int)accums.size();
+            accums.push_back(Accum{r.x0, r.y, r.x1 - 1, r.y, 0, 0, 0});
+        }
+        Accum& a(accums[idx]);
+        int len = r.x1 - r.x0;
+        a.min_x = std::min(a.min_x, r.x0);
+        a.max_x = std::max(a.max_x, r.x1 - 1);
+        a.min_y = std::min(a.min_y, r.y);
+        a.max_y = std::max(a.max_y, r.y);
+        a.area += len;
+        a.sum_x += (int64_t)(r.x0 + r.x1 - 1) * len / 2;
+        a.sum_y += (int64_t)r.y * len;
+    }
+
+    for (const Accum& a : accums)
+    {
+        if (a.area < min_area)
+            continue;
+        MotionBlob b;
+        b.region = ZMB::MakeRegion(a.min_x, a.min_y, a.max_x - a.min_x + 1, a.max_y - a.min_y + 1);
+        b.area = a.area;
+        b.centroid = glm::vec2((float)a.sum_x / a.area, (float)a.sum_y / a.area);
+        result.push_back(b);
+    }
+    std::sort(result.begin(), result.end(),
+              [](const MotionBlob& l, const MotionBlob& r) { return l.area > r.area; });
+    return result;
+}
+
+void ScaleBlobs(std::vector<MotionBlob>& blobs, float sx, float sy)
+{
+    for (MotionBlob& b : blobs)
+    {
+        int x0 = (int)std::floor(b.region.left() * sx);
+        int y0 = (int)std::floor(b.region.bottom() * sy);
+        int x1 = (int)std::ceil(b.region.right() * sx);
+        int y1 = (int)std::ceil(b.region.top() * sy);
+        b.region = ZMB::MakeRegion(x0, y0, x1 - x0, y1 - y0);
+        b.area = (int)std::lround(b.area * sx * sy);
+        b.centroid = glm::vec2(b.centroid.x * sx, b.centroid.y * sy);
+    }
+}
+
+void OffsetBlobs(std::vector<MotionBlob>& blobs, int dx, int dy)
+{
+    for (MotionBlob& b : blobs)
+    {
+        b.region = ZMB::MakeRegion(b.region.left() + dx, b.region.bottom() + dy, b.region.width(), b.region.height());
+        b.centroid += glm::vec2((float)dx, (float)dy);
+    }
+}
+
+}//ZMBEntities
@@ -0,0 +1,76 @@
+#ifndef BLOB_EXTRACTOR_H
+#define BLOB_EXTRACTOR_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include "../src/mimage.h"
+
+namespace ZMBEntities {
+
+/** A connected area of the motion mask.*/
+struct MotionBlob
+{
+    ZMB::MRegion region;//< bounding box, see ZMB::MakeRegion()
+    int area = 0;       //< foreground pixels
+    glm::vec2 centroid; //< mean of the foreground pixels' coordinates
+    uint32_t track_id = 0;  //< set by the BlobTracker, 0: not tracked
+    int64_t dwell_usec = 0; //< set by the BlobTracker: time since the track started
+};
+
+/** Connected components of a binary mask in two passes over run-lengths:
+ * 1) each row is encoded as runs of foreground pixels, a run is merged
+ *    (union-find) with the overlapping runs of the previous row;
+ * 2) the runs' areas, bounds and coordinate sums are accumulated per root.
+ * Works on the downscaled detection mask, so a frame is a few thousand pixels
+ * and a few hundred runs at most. The buffers are reused between calls.
+ * Not thread-safe.*/
+class BlobExtractor
+{
+public:
+    BlobExtractor() : min_area(4), eight_connected(true) { }
+
+    /** @param mask -- 8-bit, non-zero is the foreground.
+     * @return blobs of at least (min_area) pixels, largest first.*/
+    const std::vector<MotionBlob>& extract(const uint8_t* mask, int width, int height, int stride);
+
+    const std::vector<MotionBlob>& blobs() const {return result;}
+
+    int min_area;
+    bool eight_connected;
+
+private:
+    struct Run
+    {
+        int y;
+        int x0;
+        int x1;//< past the last pixel
+        int label;
+    };
+
+    struct Accum
+    {
+        int min_x, min_y, max_x, max_y;
+        int area;
+        int64_t sum_x, sum_y;
+    };
+
+    int find(int label);
+    void unite(int a, int b);
+
+    std::vector<Run> runs;
+    std::vector<int> parent;
+    std::vector<int> root_to_blob;
+    std::vector<Accum> accums;
+    std::vector<MotionBlob> result;
+};
+
+/** Scale blobs from the detection resolution to the source frame's.*/
+void ScaleBlobs(std::vector<MotionBlob>& blobs, float sx, float sy);
+
+/** Move blobs from a crop's coordinates to the frame's, (dx, dy) is the crop's first column and row.*/
+void OffsetBlobs(std::vector<MotionBlob>& blobs, int dx, int dy);
+
+}//ZMBEntities
+
+#endif // BLOB_EXTRACTOR_H
@@ -0,0 +1,258 @@
+#include "blob_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ZMBEntities {
+
+void TrackSoA::push(uint32_t track_id, float x, float y, float bw, float bh, int64_t ts_usec)
+{
+    id.push_back(track_id);
+    cx.push_back(x);
+    cy.push_back(y);
+    w.push_back(bw);
+    h.push_back(bh);
+    vx.push_back(0.0f);
+    vy.push_back(0.0f);
+    first_usec.push_back(ts_usec);
+    last_usec.push_back(ts_usec);
+    hits.push_back(1);
+    misses.push_back(0);
+}
+
+template<typename T>
+static inline void SwapRemove(std::vector<T>& v, size_t i)
+{
+    v[i] = v.back();
+    v.pop_back();
+}
+
+void TrackSoA::swap_remove(size_t i)
+{
+    SwapRemove(id, i);
+    SwapRemove(cx, i);
+    SwapRemove(cy, i);
+    SwapRemove(w, i);
+    SwapRemove(h, i);
+    SwapRemove(vx, i);
+    SwapRemove(vy, i);
+    SwapRemove(first_usec, i);
+    SwapRemove(last_usec, i);
+    SwapRemove(hits, i);
+    SwapRemove(misses, i);
+}
+
+void TrackSoA::clear()
+{
+    id.clear(); cx.clear(); cy.clear(); w.clear(); h.clear();
+    vx.clear(); vy.clear(); first_usec.clear(); last_usec.clear();
+    hits.clear(); misses.clear();
+}
+
+//-----------------------------------------------------------------------------
+void BlobTracker::reset()
+{
+    soa.clear();
+    confirmed_cnt = 0;
+    last_ts_usec = -1;
+    frame_events.clear();
+}
+
+ZMB::MRegion BlobTracker::track_region(size_t i) const
+{
+    return ZMB::MakeRegion((int)std::lround(soa.cx[i] - soa.w[i] * 0.5f),
+                           (int)std::lround(soa.cy[i] - soa.h[i] * 0.5f),
+                           (int)std::lround(soa.w[i]), (int)std::lround(soa.h[i]));
+}
+
+void BlobTracker::predict(float dt)
+{
+    const size_t n = soa.size();
+    px.resize(n);
+    py.resize(n);
+    const float* cx = soa.cx.data();
+    const float* cy = soa.cy.data();
+    const float* vx = soa.vx.data();
+    const float* vy = soa.vy.data();
+    for (size_t i = 0; i < n; ++i)
+    {
+        px[i] = cx[i] + vx[i] * dt;
+        py[i] = cy[i] + vy[i] * dt;
+    }
+}
+
+void BlobTracker::collect_candidates(const std::vector<MotionBlob>& blobs)
+{
+    items.clear();
+    for (size_t i = 0; i < soa.size(); ++i)
+    {
+        float hw = soa.w[i] * 0.5f, hh = soa.h[i] * 0.5f;
+        items.push_back(SweepItem{px[i] - hw, px[i] + hw, py[i] - hh, py[i] + hh, (int)i, true});
+    }
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+        const ZMB::MRegion& r(blobs[i].region);
+        items.push_back(SweepItem{(float)r.left(), (float)r.right(),
+                                  (float)r.bottom(), (float)r.top(), (int)i, false});
+    }
+    std::sort(items.begin(), items.end(),
+              [](const SweepItem& l, const SweepItem& r) { return l.x0 < r.x0; });
+
+    candidates.clear();
+    pair_tracks.clear();
+    pair_blobs.clear();
+    active_tracks.clear();
+    active_blobs.clear();
+    for (size_t c = 0; c < items.size(); ++c)
+    {
+        const SweepItem& it(items[c]);
+        //drop the boxes ending before this one starts
+        auto fn_expire = [this, &it](std::vector<int>& active)
+        {
+            size_t k = 0;
+            for (int a : active)
+            {
+                if (items[a].x1 > it.x0)
+                    active[k++] = a;
+            }
+            active.resize(k);
+        };
+        fn_expire(active_tracks);
+        fn_expire(active_blobs);
+
+        //pairs are only made with the other kind
+        for (int a : (it.is_track ? active_blobs : active_tracks))
+        {
+            const SweepItem& o(items[a]);
+            if (std::min(it.x1, o.x1) <= std::max(it.x0, o.x0) || std::min(it.y1, o.y1) <= std::max(it.y0, o.y0))
+                continue;
+            const SweepItem& tr(it.is_track ? it : o);
+            const SweepItem& bl(it.is_track ? o : it);
+            pair_tracks.push_back((int)std::lround(tr.x0), (int)std::lround(tr.y0),
+                                  (int)std::lround(tr.x1), (int)std::lround(tr.y1));
+            pair_blobs.push_back((int)bl.x0, (int)bl.y0, (int)bl.x1, (int)bl.y1);
+            candidates.push_back(Candidate{0.0f, tr.idx, bl.idx});
+        }
+        (it.is_track ? active_tracks : active_blobs).push_back((int)c);
+    }
+
+    //all the overlapping pairs' IoU at once
+    pair_iou.resize(candidates.size());
+    pair_tracks.iou(pair_blobs, pair_iou.data());
+    size_t k = 0;
+    for (size_t c = 0; c < candidates.size(); ++c)
+    {
+        if (pair_iou[c] < params.min_iou)
+            continue;
+        candidates[k] = candidates[c];
+        candidates[k++].iou = pair_iou[c];
+    }
+    candidates.resize(k);
+}
+
+const std::vector<TrackEvent>& BlobTracker::update(std::vector<MotionBlob>& blobs, int64_t ts_usec)
+{
+    frame_events.clear();
+    float dt = (last_ts_usec < 0 || ts_usec <= last_ts_usec) ? 0.0f : (ts_usec - last_ts_usec) * 1e-6f;
+    last_ts_usec = ts_usec;
+
+    predict(dt);
+    collect_candidates(blobs);
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& l, const Candidate& r) { return l.iou > r.iou; });
+
+    track_match.assign(soa.size(), -1);
+    blob_match.assign(blobs.size(), -1);
+    for (const Candidate& c : candidates)
+    {
+        if (track_match[c.track] >= 0 || blob_match[c.blob] >= 0)
+            continue;
+        track_match[c.track] = c.blob;
+        blob_match[c.blob] = c.track;
+    }
+
+    //matched tracks: correct the prediction
+    for (size_t i = 0; i < soa.size(); ++i)
+    {
+        int b = track_match[i];
+        if (b < 0)
+        {//coast on the prediction
+            soa.cx[i] = px[i];
+            soa.cy[i] = py[i];
+            ++soa.misses[i];
+            continue;
+        }
+        const MotionBlob& blob(blobs[b]);
+        const ZMB::MRegion& r(blob.region);
+        float mx = 0.5f * (r.left() + r.right());
+        float my = 0.5f * (r.bottom() + r.top());
+        float rx = mx - px[i];
+        float ry = my - py[i];
+        soa.cx[i] = px[i] + params.alpha * rx;
+        soa.cy[i] = py[i] + params.alpha * ry;
+        if (dt > 0.0f)
+        {
+            soa.vx[i] += params.beta * rx / dt;
+            soa.vy[i] += params.beta * ry / dt;
+        }
+        soa.w[i] += params.alpha * ((float)r.width() - soa.w[i]);
+        soa.h[i] += params.alpha * ((float)r.height() - soa.h[i]);
+        soa.last_usec[i] = ts_usec;
+        soa.misses[i] = 0;
+        if (soa.hits[i] < 0xFFFF)
+            ++soa.hits[i];
+        if (params.confirm_hits == soa.hits[i])
+        {
+            ++confirmed_cnt;
+            frame_events.push_back(TrackEvent{TrackEvent::Started, soa.id[i], track_region(i),
+                                              ts_usec - soa.first_usec[i]});
+        }
+    }
+
+    //lost tracks, backwards: swap_remove() moves the last one here
+    for (size_t i = soa.size(); i-- > 0; )
+    {
+        if (soa.misses[i] <= params.max_misses)
+            continue;
+        if (soa.hits[i] >= params.confirm_hits)
+        {
+            --confirmed_cnt;
+            frame_events.push_back(TrackEvent{TrackEvent::Ended, soa.id[i], track_region(i),
+                                              soa.last_usec[i] - soa.first_usec[i]});
+        }
+        soa.swap_remove(i);
+        //keep the matches aligned with the tracks
+        track_match[i] = track_match.back();
+        track_match.pop_back();
+    }
+    for (size_t i = 0; i < track_match.size(); ++i)
+    {
+        if (track_match[i] >= 0)
+        {
+            MotionBlob& blob(blobs[track_match[i]]);
+            blob.track_id = soa.id[i];
+            blob.dwell_usec = ts_usec - soa.first_usec[i];
+        }
+    }
+
+    //new tentative tracks
+    for (size_t b = 0; b < blobs.size() && soa.size() < params.max_tracks; ++b)
+    {
+        if (blob_match[b] >= 0)
+            continue;
+        const ZMB::MRegion& r(blobs[b].region);
+        soa.push(next_id, 0.5f * (r.left() + r.right()), 0.5f * (r.bottom() + r.top()),
+                 (float)r.width(), (float)r.height(), ts_usec);
+        blobs[b].track_id = next_id;
+        blobs[b].dwell_usec = 0;
+        if (params.confirm_hits <= 1)
+        {
+            ++confirmed_cnt;
+            frame_events.push_back(TrackEvent{TrackEvent::Started, next_id, r, 0});
+        }
+        next_id = (0xFFFFFFFF == next_id) ? 1 : next_id + 1;
+    }
+    return frame_events;
+}
+
+}//ZMBEntities
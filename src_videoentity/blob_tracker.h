@@ -0,0 +1,121 @@
+#ifndef BLOB_TRACKER_H
+#define BLOB_TRACKER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "blob_extractor.h"
+#include "../src/mregion_batch.h"
+
+namespace ZMBEntities {
+
+struct BlobTrackerParams
+{
+    float min_iou = 0.15f;   //< of the predicted track's box and the blob
+    float alpha = 0.6f;      //< position gain of the alpha-beta predictor
+    float beta = 0.15f;      //< velocity gain
+    int confirm_hits = 3;    //< matched frames before the track is reported (blicks don't get that far)
+    int max_misses = 6;      //< unmatched frames before the track is dropped
+    size_t max_tracks = 512;
+};
+
+/** Appearance and disappearance of a confirmed track.*/
+struct TrackEvent
+{
+    enum Kind { Started, Ended };
+
+    Kind kind;
+    uint32_t id;
+    ZMB::MRegion region;
+    int64_t dwell_usec;//< time since the track's first blob
+};
+
+/** Tracks' state, structure of arrays: the predict and the sweep
+ * read only the coordinates, not the whole records.*/
+struct TrackSoA
+{
+    std::vector<uint32_t> id;
+    std::vector<float> cx, cy;  //< box center
+    std::vector<float> w, h;
+    std::vector<float> vx, vy;  //< center's velocity, pixels per second
+    std::vector<int64_t> first_usec;
+    std::vector<int64_t> last_usec;
+    std::vector<uint16_t> hits;
+    std::vector<uint16_t> misses;
+
+    size_t size() const {return id.size();}
+    void push(uint32_t track_id, float x, float y, float bw, float bh, int64_t ts_usec);
+    /** Remove the i-th track, the last one takes it's place.*/
+    void swap_remove(size_t i);
+    void clear();
+};
+
+/** Associates the motion blobs frame to frame, giving them stable IDs.
+ *
+ * Each frame:
+ * 1) the tracks are predicted to the frame's time (alpha-beta filter,
+ *    a constant-gain Kalman filter of a constant velocity model);
+ * 2) candidate pairs are the predicted boxes and blobs overlapping along x,
+ *    found by sorting all the boxes by their left edge and sweeping (O(n log n));
+ * 3) the overlapping pairs' IoU is computed in one batch (ZMB::MRegionBatch),
+ *    pairs with IoU >= min_iou are matched greedily, best IoU first;
+ * 4) unmatched blobs start tentative tracks, unmatched tracks miss a frame.
+ *
+ * Only confirmed tracks produce events, so an object is reported once
+ * however long it stays, and it's dwell time is known.
+ * Not thread-safe: one per detector.*/
+class BlobTracker
+{
+public:
+    BlobTracker() : next_id(1), confirmed_cnt(0), last_ts_usec(-1) { }
+    explicit BlobTracker(const BlobTrackerParams& p) : BlobTracker() { params = p; }
+
+    /** Track this frame's blobs, their track_id and dwell_usec are set.
+     * @return the tracks started and ended on this frame.*/
+    const std::vector<TrackEvent>& update(std::vector<MotionBlob>& blobs, int64_t ts_usec);
+
+    void reset();
+
+    /** Tracks having at least (confirm_hits).*/
+    int confirmed() const {return confirmed_cnt;}
+    const TrackSoA& tracks() const {return soa;}
+    const std::vector<TrackEvent>& events() const {return frame_events;}
+
+    BlobTrackerParams params;
+
+private:
+    struct SweepItem
+    {
+        float x0, x1, y0, y1;
+        int idx;
+        bool is_track;
+    };
+    struct Candidate
+    {
+        float iou;
+        int track;
+        int blob;
+    };
+
+    void predict(float dt);
+    void collect_candidates(const std::vector<MotionBlob>& blobs);
+    ZMB::MRegion track_region(size_t i) const;
+
+    TrackSoA soa;
+    uint32_t next_id;
+    int confirmed_cnt;
+    int64_t last_ts_usec;
+
+    std::vector<float> px, py;//< predicted centers
+    std::vector<SweepItem> items;
+    std::vector<int> active_tracks, active_blobs;
+    std::vector<Candidate> candidates;
+    ZMB::MRegionBatch pair_tracks, pair_blobs;//< candidates' boxes, the tracks' ones rounded
+    std::vector<float> pair_iou;
+    std::vector<int> track_match, blob_match;
+    std::vector<TrackEvent> frame_events;
+};
+
+}//ZMBEntities
+
+#endif // BLOB_TRACKER_H
@@ -0,0 +1,350 @@
+#include "decoder_policy.h"
+
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+#include <iterator>
+
+#if defined(__unix) || defined(__APPLE__)
+#include <time.h>
+#endif
+#if defined(__linux__)
+#include <dirent.h>
+#include <cstdlib>
+#endif
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace ZMBEntities {
+
+static int64_t ThreadCpuUsec()
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return 0;
+#endif
+}
+
+/** CPU time of a thread of the process by it's kernel id, -1 when it has exited.*/
+static int64_t ThreadCpuUsec(int tid)
+{
+#if defined(__linux__)
+    //the per-thread CPUCLOCK_SCHED clock, as pthread_getcpuclockid() makes it
+    clockid_t clock = (clockid_t)((int)(~(unsigned)tid << 3) | 6);
+    struct timespec ts;
+    if (0 != clock_gettime(clock, &ts))
+        return -1;
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    (void)tid;
+    return -1;
+#endif
+}
+
+/** Kernel ids of the process' threads, sorted.*/
+static std::vector<int> ProcessThreads()
+{
+    std::vector<int> res;
+#if defined(__linux__)
+    DIR* dir = opendir("/proc/self/task");
+    if (nullptr == dir)
+        return res;
+    while (struct dirent* ent = readdir(dir))
+    {
+        if ('.' != ent->d_name[0])
+            res.push_back(std::atoi(ent->d_name));
+    }
+    closedir(dir);
+    std::sort(res.begin(), res.end());
+#endif
+    return res;
+}
+
+static int64_t MonotonicUsec()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//-----------------------------------------------------------------------------
+DecoderCoreBudget& DecoderCoreBudget::instance()
+{
+    static DecoderCoreBudget budget;
+    return budget;
+}
+
+DecoderCoreBudget::DecoderCoreBudget()
+    : total(std::max(1u, std::thread::hardware_concurrency())), in_use(0)
+{
+
+}
+
+void DecoderCoreBudget::set_budget(int cores)
+{
+    std::unique_lock<std::mutex> lk(mutex);
+    total = std::max(1, cores);
+}
+
+int DecoderCoreBudget::budget() const
+{
+    std::unique_lock<std::mutex> lk(mutex);
+    return total;
+}
+
+int DecoderCoreBudget::used() const
+{
+    std::unique_lock<std::mutex> lk(mutex);
+    return in_use;
+}
+
+int DecoderCoreBudget::acquire(int wanted)
+{
+    std::unique_lock<std::mutex> lk(mutex);
+    //each decoder has at least it's own thread, even over the budget
+    int granted = std::max(1, std::min(wanted, total - in_use));
+    in_use += granted;
+    return granted;
+}
+
+void DecoderCoreBudget::release(int granted)
+{
+    std::unique_lock<std::mutex> lk(mutex);
+    in_use = std::max(0, in_use - granted);
+}
+
+//-----------------------------------------------------------------------------
+DecoderThreadsLease::DecoderThreadsLease(int wanted)
+    : granted(DecoderCoreBudget::instance().acquire(wanted))
+{
+
+}
+
+int DecoderThreadsLease::acquire(int wanted)
+{
+    reset();
+    granted = DecoderCoreBudget::instance().acquire(wanted);
+    return granted;
+}
+
+void DecoderThreadsLease::reset()
+{
+    if (granted > 0)
+        DecoderCoreBudget::instance().release(granted);
+    granted = 0;
+}
+
+//-----------------------------------------------------------------------------
+/** Decoding cost relative to H.264 Main/High at the same pixel rate.*/
+static double CodecCostFactor(const AVCodecContext* ctx)
+{
+    switch (ctx->codec_id)
+    {
+    case AV_CODEC_ID_HEVC:
+        return 2.0;
+    case AV_CODEC_ID_H264:
+        //4:2:2/4:4:4 and 10-bit profiles
+        return (ctx->profile >= FF_PROFILE_H264_HIGH_10) ? 1.5 : 1.0;
+    case AV_CODEC_ID_MJPEG:
+        return 0.7;
+    case AV_CODEC_ID_MPEG4:
+        return 0.6;
+    default:
+        return 1.0;
+    }
+}
+
+int DecoderThreadingPolicy::wanted_threads(const AVCodecContext* ctx, double fps) const
+{
+    if (Fixed == mode)
+        return std::max(1, fixed_threads);
+    if (nullptr == ctx || ctx->width <= 0 || ctx->height <= 0)
+        return 1;
+
+    if (fps <= 0.0)
+        fps = 25.0;
+    double pixel_rate = (double)ctx->width * ctx->height * fps * CodecCostFactor(ctx);
+    int n = (int)std::ceil(pixel_rate / core_pixel_rate);
+    return std::max(1, std::min(n, max_threads));
+}
+
+DecoderThreading DecoderThreadingPolicy::choose(const AVCodecContext* ctx, double fps, DecoderThreadsLease& lease) const
+{
+    int wanted = wanted_threads(ctx, fps);
+
+    DecoderThreading res;
+    if (wanted <= 1)
+    {//no threads are spawned by the codec at all
+        lease.acquire(1);
+        res.threads = 1;
+        return res;
+    }
+
+    bool can_frame = nullptr != ctx && nullptr != ctx->codec
+            && 0 != (ctx->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS);
+    bool can_slice = nullptr != ctx && nullptr != ctx->codec
+            && 0 != (ctx->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS);
+
+    switch (mode)
+    {
+    case Slice:
+        res.thread_type = "slice";
+        break;
+    case Frame:
+    case Fixed:
+        res.thread_type = "frame";
+        break;
+    default:
+        res.thread_type = (can_frame || !can_slice) ? "frame" : "slice";
+        break;
+    }
+
+    res.threads = lease.acquire(wanted);
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+int ApplyDecodeProfile(AVCodecContext* ctx, const DecodeProfileParams& params)
+{
+    if (nullptr == ctx || DecodeProfile::Full == params.profile)
+        return 0;
+
+    ctx->skip_loop_filter = AVDISCARD_ALL;
+    ctx->skip_idct = AVDISCARD_NONREF;
+    //favour speed over spec-compliance where the decoder has such shortcuts
+    ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+    if (DecodeProfile::MotionVectors == params.profile)
+    {//the vectors are in the full resolution coordinates
+        ctx->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS;
+        ctx->lowres = 0;
+        return 0;
+    }
+
+    int max_lowres = (nullptr != ctx->codec) ? ctx->codec->max_lowres : 0;
+    int lowres = 0;
+    while (lowres < max_lowres)
+    {
+        int64_t w = ctx->width >> (lowres + 1);
+        int64_t h = ctx->height >> (lowres + 1);
+        if (w * h < params.analysis_min_pixels)
+            break;
+        ++lowres;
+    }
+    ctx->lowres = lowres;
+    return lowres;
+}
+
+const char* DecodeProfileName(DecodeProfile profile)
+{
+    switch (profile)
+    {
+    case DecodeProfile::Analysis:
+        return "analysis";
+    case DecodeProfile::MotionVectors:
+        return "mv";
+    default:
+        return "full";
+    }
+}
+
+//-----------------------------------------------------------------------------
+DecoderStats::DecoderStats()
+    : frames_cnt(0), cpu_time_usec(0), worker_time_usec(0), workers_cnt(0), wall_time_usec(0), first_frame_usec(-1),
+      call_cpu_start(0), call_wall_start(0)
+{
+
+}
+
+void DecoderStats::begin()
+{
+    call_cpu_start = ThreadCpuUsec();
+    call_wall_start = MonotonicUsec();
+}
+
+void DecoderStats::end(bool got_frame)
+{
+    int64_t wall = MonotonicUsec();
+    cpu_time_usec.fetch_add((uint64_t)std::max<int64_t>(0, ThreadCpuUsec() - call_cpu_start));
+    wall_time_usec.fetch_add((uint64_t)std::max<int64_t>(0, wall - call_wall_start));
+    sample_workers();
+    if (!got_frame)
+        return;
+    if (0 == frames_cnt.fetch_add(1))
+        first_frame_usec.store(wall);
+}
+
+void DecoderStats::sample_workers()
+{
+    uint64_t spent = 0;
+    for (size_t c = 0; c < worker_tids.size(); ++c)
+    {
+        int64_t now = ThreadCpuUsec(worker_tids[c]);
+        if (now < worker_cpu_last[c])
+            continue;
+        spent += (uint64_t)(now - worker_cpu_last[c]);
+        worker_cpu_last[c] = now;
+    }
+    if (spent > 0)
+        worker_time_usec.fetch_add(spent);
+}
+
+double DecoderStats::fps() const
+{
+    int64_t first = first_frame_usec.load();
+    uint64_t n = frames_cnt.load();
+    if (first < 0 || n < 2)
+        return 0.0;
+    int64_t span = MonotonicUsec() - first;
+    return span > 0 ? (double)(n - 1) * 1e6 / (double)span : 0.0;
+}
+
+std::string DecoderStats::to_string() const
+{
+    std::stringstream ss;
+    uint64_t n = frames();
+    ss << "frames: " << n
+       << " fps: " << fps()
+       << " cpu ms: " << cpu_usec() / 1000
+       << " (workers: " << workers() << ", " << worker_cpu_usec() / 1000 << " ms)"
+       << " wall ms: " << wall_usec() / 1000
+       << " cpu us/frame: " << (n > 0 ? cpu_usec() / n : 0)
+       << " wall us/frame: " << (n > 0 ? wall_usec() / n : 0);
+    return ss.str();
+}
+
+//-----------------------------------------------------------------------------
+static std::mutex& DecoderOpenMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+DecoderOpenScope::DecoderOpenScope(DecoderStats& stats)
+    : stats(stats), lock(DecoderOpenMutex()), threads_before(ProcessThreads())
+{
+
+}
+
+DecoderOpenScope::~DecoderOpenScope()
+{
+    //a reopened decoder: account the old workers, then follow the new ones
+    stats.sample_workers();
+    std::vector<int> threads_after(ProcessThreads());
+    stats.worker_tids.clear();
+    std::set_difference(threads_after.begin(), threads_after.end(),
+                        threads_before.begin(), threads_before.end(),
+                        std::back_inserter(stats.worker_tids));
+    stats.worker_cpu_last.resize(stats.worker_tids.size());
+    for (size_t c = 0; c < stats.worker_tids.size(); ++c)
+        stats.worker_cpu_last[c] = std::max<int64_t>(0, ThreadCpuUsec(stats.worker_tids[c]));
+    stats.workers_cnt.store(stats.worker_tids.size());
+}
+
+}//ZMBEntities
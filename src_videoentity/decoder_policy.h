@@ -0,0 +1,207 @@
+#ifndef DECODER_POLICY_H
+#define DECODER_POLICY_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+struct AVCodecContext;
+
+namespace ZMBEntities {
+
+/** Cores for decoding shared by all the open decoders of the process.
+ * Each decoder leases threads on open() and returns them on close,
+ * a decoder always gets at least 1 thread.*/
+class DecoderCoreBudget
+{
+public:
+    static DecoderCoreBudget& instance();
+
+    /** Default is the number of CPU cores.*/
+    void set_budget(int cores);
+    int budget() const;
+    int used() const;
+
+    /** @return granted number of threads, [1, wanted].*/
+    int acquire(int wanted);
+    void release(int granted);
+
+private:
+    DecoderCoreBudget();
+
+    mutable std::mutex mutex;
+    int total;
+    int in_use;
+};
+
+/** Threads leased from the DecoderCoreBudget, returned on destruction.*/
+class DecoderThreadsLease
+{
+public:
+    DecoderThreadsLease() : granted(0) { }
+    explicit DecoderThreadsLease(int wanted);
+    ~DecoderThreadsLease() { reset(); }
+
+    DecoderThreadsLease(const DecoderThreadsLease&) = delete;
+    DecoderThreadsLease& operator = (const DecoderThreadsLease&) = delete;
+
+    /** Release the current lease, then take up to (wanted) threads.
+     * @return granted number of threads.*/
+    int acquire(int wanted);
+    void reset();
+    int threads() const {return granted;}
+
+private:
+    int granted;
+};
+
+/** Codec options chosen by the policy.*/
+struct DecoderThreading
+{
+    int threads = 1;
+    std::string thread_type = "slice";//< "frame" or "slice" (see AVCodecContext::thread_type)
+
+    /** "threads" option value for av::CodecContext::open() */
+    std::string threads_option() const {return std::to_string(threads);}
+};
+
+/** Chooses decoder's threading from the stream's resolution, frame rate, codec and profile.
+ *
+ * Mode::Auto : threads = pixel rate weighted by codec cost / one core's decoding rate,
+ *   frame threading for multi-threaded streams if the codec supports it (better throughput,
+ *   adds (threads - 1) frames of latency), slice threading otherwise.
+ * Mode::Frame, Mode::Slice : same thread count, given threading type.
+ * Mode::Fixed : (fixed_threads) threads, frame threading.
+ * Small streams get 1 thread, so hundreds of cameras don't oversubscribe the box.
+ */
+struct DecoderThreadingPolicy
+{
+    enum Mode { Auto, Frame, Slice, Fixed };
+
+    Mode mode = Auto;
+    int fixed_threads = 1;
+    int max_threads = 16;
+    /** Pixels per second of H.264 one core decodes, 1080p60 by default.*/
+    double core_pixel_rate = 1920.0 * 1080.0 * 60.0;
+
+    /** How many threads the stream needs, before the budget.
+     * @param fps -- stream's frame rate, 25 if unknown(<= 0).*/
+    int wanted_threads(const AVCodecContext* ctx, double fps) const;
+
+    /** Lease the threads and fill the options. The lease must live as long as the decoder.*/
+    DecoderThreading choose(const AVCodecContext* ctx, double fps, DecoderThreadsLease& lease) const;
+};
+
+//-----------------------------------------------------------------------------
+/** What the decoded pictures are used for.
+ * Full : archive/preview consumers, bit-exact decoding.
+ * Analysis : only the motion detector looks at the frames (downscaled ~8x),
+ *   the decoder skips the work invisible at that scale:
+ *   - skip_loop_filter=all : no deblocking (the biggest saving for H.264/HEVC);
+ *   - skip_idct=nonref : no residuals on non-reference frames, they are not predicted from;
+ *   - lowres : decode at 1/2^n resolution where the codec supports it (MJPEG, MPEG-4 ASP),
+ *     but not below (analysis_min_pixels).
+ * The errors drift until the next key frame, harmless for background subtraction.
+ * MotionVectors : Analysis without lowres, plus flags2 +export_mvs for CVBGS::MVAlgo.
+ */
+enum class DecodeProfile { Full, Analysis, MotionVectors };
+
+struct DecodeProfileParams
+{
+    DecodeProfile profile = DecodeProfile::Full;
+    /** Lowres never goes below this area: a 2x margin over MOG2Algo's 1080p/64 in each dimension.*/
+    int analysis_min_pixels = 1920 * 1080 / 16;
+};
+
+/** Set the profile's options on the codec context, must be called before it's opened.
+ * The codec must be set already (for its max_lowres).
+ * @return lowres level applied (0: full resolution).*/
+int ApplyDecodeProfile(AVCodecContext* ctx, const DecodeProfileParams& params);
+
+const char* DecodeProfileName(DecodeProfile profile);
+
+//-----------------------------------------------------------------------------
+/** Per-decoder counters, updated by the decoding thread and read by any.*/
+class DecoderStats
+{
+public:
+    DecoderStats();
+
+    /** Wrap a decode() call: begin() before, end(got_frame) after.*/
+    void begin();
+    void end(bool got_frame);
+
+    uint64_t frames() const {return frames_cnt.load();}
+
+    /** Decoded frames per second of wall clock since the first frame.*/
+    double fps() const;
+
+    /** CPU time of the decoding: the decoding thread in decode() calls
+     * plus the codec's worker threads (see DecoderOpenScope), microseconds.
+     * Without a DecoderOpenScope around the open, or off Linux, the frame/slice threading
+     * workers are not included: compare with wall_usec() then.*/
+    uint64_t cpu_usec() const {return cpu_time_usec.load() + worker_time_usec.load();}
+
+    /** Part of cpu_usec() spent by the codec's worker threads.*/
+    uint64_t worker_cpu_usec() const {return worker_time_usec.load();}
+
+    /** Number of the codec's worker threads found by the DecoderOpenScope.*/
+    size_t workers() const {return workers_cnt.load();}
+
+    /** Wall clock time spent in decode() calls, microseconds.*/
+    uint64_t wall_usec() const {return wall_time_usec.load();}
+
+    std::string to_string() const;
+
+private:
+    friend class DecoderOpenScope;
+
+    /** Re-read the CPU clocks of the workers, they keep the last value after the thread exits.*/
+    void sample_workers();
+
+    std::atomic<uint64_t> frames_cnt;
+    std::atomic<uint64_t> cpu_time_usec;
+    std::atomic<uint64_t> worker_time_usec;
+    std::atomic<size_t> workers_cnt;
+    std::atomic<uint64_t> wall_time_usec;
+    std::atomic<int64_t> first_frame_usec;
+    int64_t call_cpu_start;
+    int64_t call_wall_start;
+    //the decoding thread's only
+    std::vector<int> worker_tids;
+    std::vector<int64_t> worker_cpu_last;
+};
+
+/** Finds the codec's worker threads for the DecoderStats: both the frame and the slice
+ * threading spawn them when the codec is opened, so they are the process' threads
+ * that appeared while the scope lived. Open the decoder inside it:
+ * @code
+   {
+       DecoderOpenScope scope(stats);
+       vdec.open(...);
+   }
+ * @endcode
+ * The scopes of all the decoders are serialized. Threads spawned by any other code
+ * while a decoder is opened would be counted too. Linux only (/proc/self/task),
+ * elsewhere the scope does nothing.*/
+class DecoderOpenScope
+{
+public:
+    explicit DecoderOpenScope(DecoderStats& stats);
+    ~DecoderOpenScope();
+
+    DecoderOpenScope(const DecoderOpenScope&) = delete;
+    DecoderOpenScope& operator = (const DecoderOpenScope&) = delete;
+
+private:
+    DecoderStats& stats;
+    std::unique_lock<std::mutex> lock;
+    std::vector<int> threads_before;
+};
+
+}//ZMBEntities
+
+#endif // DECODER_POLICY_H
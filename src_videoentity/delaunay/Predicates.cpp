@@ -0,0 +1,209 @@
+/**
+  Robust geometric predicates: a floating-point filter with the exact
+  expansion arithmetic fallback (J. R. Shewchuk, "Adaptive Precision
+  Floating-Point Arithmetic and Fast Robust Geometric Predicates", 1997).
+ */
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include "Predicates.h"
+
+namespace JVa {
+
+/** A sum of nonoverlapping doubles, increasing magnitude, no zeroes:
+ * the sign of the value is the sign of the last component.*/
+typedef std::vector<double> Expansion;
+
+static const double EPSILON = std::ldexp(1.0, -53);
+static const double CCW_ERRBOUND = (3.0 + 16.0 * EPSILON) * EPSILON;
+static const double ICC_ERRBOUND = (10.0 + 96.0 * EPSILON) * EPSILON;
+
+static inline void TwoSum(double a, double b, double& x, double& y)
+{
+    x = a + b;
+    double bv = x - a;
+    double av = x - bv;
+    y = (a - av) + (b - bv);
+}
+
+static inline void FastTwoSum(double a, double b, double& x, double& y)
+{//|a| >= |b|
+    x = a + b;
+    y = b - (x - a);
+}
+
+static inline void TwoDiff(double a, double b, double& x, double& y)
+{
+    x = a - b;
+    double bv = a - x;
+    double av = x + bv;
+    y = (a - av) + (bv - b);
+}
+
+static inline void TwoProduct(double a, double b, double& x, double& y)
+{
+    x = a * b;
+    y = std::fma(a, b, -x);
+}
+
+static Expansion Diff(double a, double b)
+{
+    double x, y;
+    TwoDiff(a, b, x, y);
+    Expansion e;
+    if (0.0 != y) e.push_back(y);
+    if (0.0 != x) e.push_back(x);
+    return e;
+}
+
+static Expansion Sum(const Expansion& e, const Expansion& f)
+{
+    Expansion res(e);
+    for (double b : f)
+    {//grow (res) by one component
+        Expansion h;
+        h.reserve(res.size() + 1);
+        double q = b;
+        for (double ei : res)
+        {
+            double qn, hh;
+            TwoSum(q, ei, qn, hh);
+            if (0.0 != hh) h.push_back(hh);
+            q = qn;
+        }
+        if (0.0 != q) h.push_back(q);
+        res.swap(h);
+    }
+    return res;
+}
+
+static Expansion Negate(Expansion e)
+{
+    for (double& v : e)
+        v = -v;
+    return e;
+}
+
+static Expansion Scale(const Expansion& e, double b)
+{
+    Expansion h;
+    if (e.empty() || 0.0 == b)
+        return h;
+    h.reserve(2 * e.size());
+    double q, hh;
+    TwoProduct(e[0], b, q, hh);
+    if (0.0 != hh) h.push_back(hh);
+    for (size_t i = 1; i < e.size(); ++i)
+    {
+        double p1, p0, sum;
+        TwoProduct(e[i], b, p1, p0);
+        TwoSum(q, p0, sum, hh);
+        if (0.0 != hh) h.push_back(hh);
+        FastTwoSum(p1, sum, q, hh);
+        if (0.0 != hh) h.push_back(hh);
+    }
+    if (0.0 != q) h.push_back(q);
+    return h;
+}
+
+static Expansion Mul(const Expansion& e, const Expansion& f)
+{
+    Expansion res;
+    for (double b : f)
+        res = Sum(res, Scale(e, b));
+    return res;
+}
+
+static inline double Sign(const Expansion& e)
+{
+    return e.empty() ? 0.0 : e.back();
+}
+
+#ifdef __SIZEOF_INT128__
+/** Pixel coordinates: integers below 2^24, the determinants are exact in 128-bit integers,
+ * much cheaper than the expansions for the cocircular outlines of the zones.*/
+static inline bool SmallInts(const double* const* pts, int n)
+{
+    for (int i = 0; i < n; ++i)
+        for (int c = 0; c < 2; ++c)
+            if (!(std::fabs(pts[i][c]) < 16777216.0) || pts[i][c] != std::floor(pts[i][c]))
+                return false;
+    return true;
+}
+#endif
+
+double orient2d(const double* a, const double* b, const double* c)
+{
+    double detleft = (a[0] - c[0]) * (b[1] - c[1]);
+    double detright = (a[1] - c[1]) * (b[0] - c[0]);
+    double det = detleft - detright;
+    double errbound = CCW_ERRBOUND * (std::fabs(detleft) + std::fabs(detright));
+    if (det > errbound || -det > errbound)
+        return det;
+
+#ifdef __SIZEOF_INT128__
+    const double* pts[] = {a, b, c};
+    if (SmallInts(pts, 3))
+    {
+        int64_t d = ((int64_t)a[0] - (int64_t)c[0]) * ((int64_t)b[1] - (int64_t)c[1])
+                  - ((int64_t)a[1] - (int64_t)c[1]) * ((int64_t)b[0] - (int64_t)c[0]);
+        return (double)d;
+    }
+#endif
+    Expansion acx = Diff(a[0], c[0]), acy = Diff(a[1], c[1]);
+    Expansion bcx = Diff(b[0], c[0]), bcy = Diff(b[1], c[1]);
+    return Sign(Sum(Mul(acx, bcy), Negate(Mul(acy, bcx))));
+}
+
+double incircle(const double* a, const double* b, const double* c, const double* d)
+{
+    double adx = a[0] - d[0], ady = a[1] - d[1];
+    double bdx = b[0] - d[0], bdy = b[1] - d[1];
+    double cdx = c[0] - d[0], cdy = c[1] - d[1];
+
+    double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+    double cdxady = cdx * ady, adxcdy = adx * cdy;
+    double adxbdy = adx * bdy, bdxady = bdx * ady;
+    double alift = adx * adx + ady * ady;
+    double blift = bdx * bdx + bdy * bdy;
+    double clift = cdx * cdx + cdy * cdy;
+
+    double det = alift * (bdxcdy - cdxbdy)
+               + blift * (cdxady - adxcdy)
+               + clift * (adxbdy - bdxady);
+    double permanent = (std::fabs(bdxcdy) + std::fabs(cdxbdy)) * alift
+                     + (std::fabs(cdxady) + std::fabs(adxcdy)) * blift
+                     + (std::fabs(adxbdy) + std::fabs(bdxady)) * clift;
+    double errbound = ICC_ERRBOUND * permanent;
+    if (det > errbound || -det > errbound)
+        return det;
+
+#ifdef __SIZEOF_INT128__
+    const double* pts[] = {a, b, c, d};
+    if (SmallInts(pts, 4))
+    {
+        int64_t iadx = (int64_t)adx, iady = (int64_t)ady;
+        int64_t ibdx = (int64_t)bdx, ibdy = (int64_t)bdy;
+        int64_t icdx = (int64_t)cdx, icdy = (int64_t)cdy;
+        __int128 r = (__int128)(iadx * iadx + iady * iady) * (ibdx * icdy - icdx * ibdy)
+                   + (__int128)(ibdx * ibdx + ibdy * ibdy) * (icdx * iady - iadx * icdy)
+                   + (__int128)(icdx * icdx + icdy * icdy) * (iadx * ibdy - ibdx * iady);
+        return r > 0 ? 1.0 : (r < 0 ? -1.0 : 0.0);
+    }
+#endif
+    Expansion eadx = Diff(a[0], d[0]), eady = Diff(a[1], d[1]);
+    Expansion ebdx = Diff(b[0], d[0]), ebdy = Diff(b[1], d[1]);
+    Expansion ecdx = Diff(c[0], d[0]), ecdy = Diff(c[1], d[1]);
+
+    Expansion ealift = Sum(Mul(eadx, eadx), Mul(eady, eady));
+    Expansion eblift = Sum(Mul(ebdx, ebdx), Mul(ebdy, ebdy));
+    Expansion eclift = Sum(Mul(ecdx, ecdx), Mul(ecdy, ecdy));
+
+    Expansion bc = Sum(Mul(ebdx, ecdy), Negate(Mul(ecdx, ebdy)));
+    Expansion ca = Sum(Mul(ecdx, eady), Negate(Mul(eadx, ecdy)));
+    Expansion ab = Sum(Mul(eadx, ebdy), Negate(Mul(ebdx, eady)));
+
+    return Sign(Sum(Sum(Mul(ealift, bc), Mul(eblift, ca)), Mul(eclift, ab)));
+}
+
+}//JVa
@@ -0,0 +1,23 @@
+/**
+  Robust geometric predicates: a floating-point filter with the exact
+  expansion arithmetic fallback (J. R. Shewchuk, "Adaptive Precision
+  Floating-Point Arithmetic and Fast Robust Geometric Predicates", 1997).
+ */
+#ifndef JVA_PREDICATES_H
+#define JVA_PREDICATES_H
+
+namespace JVa
+{
+
+/** Sign of the doubled area of (a, b, c):
+ * > 0 if c lies to the left of a->b (counterclockwise), < 0 to the right, 0 if collinear.
+ * The sign is exact, the magnitude is approximate.*/
+double orient2d(const double* a, const double* b, const double* c);
+
+/** > 0 if d lies inside the circle through (a, b, c), counterclockwise,
+ * < 0 outside, 0 on the circle. The sign is reversed for a clockwise (a, b, c).*/
+double incircle(const double* a, const double* b, const double* c, const double* d);
+
+}//JVa
+
+#endif // JVA_PREDICATES_H
@@ -3,386 +3,781 @@
   Modified.
  */
 #include <vector>
-#include <sstream>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <random>
 #include "Triangulation.h"
+#include "Predicates.h"
 
 namespace JVa {
 using namespace std;
 
 /**
- *  Checks the position of the point 'p' respect the segment formed by the points 'a' and 'b'.
+ *  Get the enclosing triangle of the points 3..len+2, written to the vertices 0..2.
+ *  The corners are rounded outwards to integers: exact in floats for the pixel grids.
  */
-double orientation2D(const Vector2& a, const Vector2& b, const Vector2& p)
+static void enclosingTriangle(std::vector<float>& x, std::vector<float>& y, int len)
 {
-    return ((b[X] - a[X])*(p[Y] - a[Y]) - (p[X] - a[X])*(b[Y] - a[Y]))/2;
-}
+    double xmin, xmax, ymin, ymax;
 
-double orientation2D(const Vector3& a, const Vector3& b, const Vector3& p)
-{
-    return ((b[X] - a[X])*(p[Y] - a[Y]) - (p[X] - a[X])*(b[Y] - a[Y]))/2;
-}
+    xmin = xmax = x[3];
+    ymin = ymax = y[3];
 
-/**
- *  Checks if the test point 't' lies inside the circle formed by the points 'p', 'q' and 'r'.
- */
-double orientation25D(const Vector2& p, const Vector2& q, const Vector2& r, const Vector2& t)
-{
-    //p q r t
-    //a b c x
-    //a1 a2 a3
-    //b1 b2 b3
-    //c1 c2 c3
-    
-    double a1 = (q[X] - p[X]);
-    double b1 = (r[X] - p[X]);
-    double c1 = (t[X] - p[X]);
-    double a2 = (q[Y] - p[Y]);
-    double b2 = (r[Y] - p[Y]);
-    double c2 = (t[Y] - p[Y]);
-    double a3 = a1*(q[X] + p[X]) + a2 * (q[Y] + p[Y]);
-    double b3 = b1*(r[X] + p[X]) + b2 * (r[Y] + p[Y]);
-    double c3 = c1*(t[X] + p[X]) + c2 * (t[Y] + p[Y]);
-    
-    return a1*(b2*c3 - c2*b3) - (a2*(b1*c3 - c1*b3)) + a3*(b1*c2 - c1*b2);
-}
+    for(int i = 4; i < len + 3; ++i)
+    {
+        if(x[i] < xmin) xmin = x[i];
+        if(x[i] > xmax) xmax = x[i];
+        if(y[i] < ymin) ymin = y[i];
+        if(y[i] > ymax) ymax = y[i];
+    }
 
-/**
- *  Checks if the point 'p' is inside the triangle formed by 'a', 'b' and 'c'.
- */
-inline bool isInside(const Vector3 &a, const Vector3 &b, const Vector3 &c, const Vector3 &p)
-{   
-    double d = orientation2D(a, b, p);
-    double e = orientation2D(b, c, p);
-    double f = orientation2D(c, a, p);
-    
-    bool s1 = d < 0;
-    bool s2 = e < 0;
-    bool s3 = f < 0;
-    bool s4 = d > 0;
-    bool s5 = e > 0;
-    bool s6 = f > 0;
-
-    return (s1 == s2 && s2 == s3) || (s4 == s5 && s5 == s6);
+    double offset = 1000;
+    xmin = std::floor(xmin - offset);
+    ymin = std::floor(ymin - offset);
+    xmax = std::ceil(xmax + offset);
+    ymax = std::ceil(ymax + offset);
+
+    //a
+    x[0] = (float)xmin;
+    y[0] = (float)ymin;
+
+    //b
+    x[1] = (float)(xmax + (xmax - xmin));
+    y[1] = (float)ymin;
+
+    //c
+    x[2] = (float)xmin;
+    y[2] = (float)(ymax + (ymax - ymin));
 }
 
 /**
- *  Get the enclosing triangle
+ *  Position of the point on the Hilbert curve of 2^16 x 2^16 cells.
  */
-void enclosingTriangle(const Vector3* p, int len, Vector3 &a, Vector3 &b, Vector3 &c)
+static uint64_t hilbertIndex(uint32_t x, uint32_t y)
 {
-    int n = len;
-    double xmin, xmax, ymin, ymax;
-    
-    xmin = xmax = p[0][X];
-    ymin = ymax = p[0][Y];
-    
-    for(int i = 1; i < n; ++i)
+    const uint32_t n = 1u << 16;
+    uint64_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2)
     {
-	if(p[i][X] < xmin) xmin = p[i][X];
-	if(p[i][X] > xmax) xmax = p[i][X];
-	if(p[i][Y] < ymin) ymin = p[i][Y];
-	if(p[i][Y] > ymax) ymax = p[i][Y];
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t)s * s * ((3 * rx) ^ ry);
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
     }
-    
-    double offset = 1000;
-    xmin = xmin - offset;
-    ymin = ymin - offset;
-    xmax = xmax + offset;
-    ymax = ymax + offset;
-    
-    //a
-    a = Vector3(xmin, ymin, 0);
-    
-    //b
-    double k = xmax - xmin;
-    double i = k / cos(45);
-    double j = i * sin(45);
-    b = Vector3(xmax + k, ymin, 0);
-    
-    //c
-    j = ymax - ymin;
-    i = j / sin(45);
-    k = i * cos(45);
-    c = Vector3(xmin, ymax + j, 0);
+    return d;
 }
 
 /**
- *  Tests segment-segment intersection
- * 
- * @Returns
- * 	2 in case of segment-segment intersection
- *	1 in case of segment-endpoint or collinear segments
- * 	0 in case of no intersection
+ *  Biased randomized insertion order (Amenta, Choi, Rote) of the vertices 3..len+2:
+ *  the shuffled points are split in rounds of doubling size, each round is sorted
+ *  along the Hilbert curve. The shuffle keeps the expected number of flips low,
+ *  the curve keeps consecutive points close, so the walks from the last triangle are short.
  */
-int intersects(const Vector3 &a1, const Vector3 &a2, const Vector3 &b1, const Vector3 &b2)
+static void brioOrder(const std::vector<float>& x, const std::vector<float>& y, int len,
+                      std::vector<int>& order, std::vector<uint64_t>& keys)
 {
-    double res1 = orientation2D(a1, a2, b1) * orientation2D(a1, a2, b2);
-    double res2 = orientation2D(b1, b2, a1) * orientation2D(b1, b2, a2);
+    order.resize(len);
+    for (int i = 0; i < len; ++i)
+        order[i] = 3 + i;
+    if (len < 2)
+        return;
 
-    /*
-     * Segment-segment intersection
-     */
-    if(res1 < 0 && res2 < 0)
-	return 2;
-    
-    /*
-     * Segment-endpoint intersection or collinear
-     */
-    if((res1 == 0 && res2 < 0) || (res1 < 0 && res2 == 0) || (res1 == 0 && res2 == 0))
-	return 1;
-    
-    /*
-     * No intersection
-     */
-    return 0;
+    double xmin = x[3], xmax = x[3], ymin = y[3], ymax = y[3];
+    for (int i = 4; i < len + 3; ++i)
+    {
+        xmin = std::min(xmin, (double)x[i]);
+        xmax = std::max(xmax, (double)x[i]);
+        ymin = std::min(ymin, (double)y[i]);
+        ymax = std::max(ymax, (double)y[i]);
+    }
+    double scale = 65535.0 / std::max(std::max(xmax - xmin, ymax - ymin), 1e-30);
+    keys.resize(len + 3);
+    for (int i = 3; i < len + 3; ++i)
+    {
+        keys[i] = hilbertIndex((uint32_t)((x[i] - xmin) * scale),
+                               (uint32_t)((y[i] - ymin) * scale));
+    }
+
+    //fixed seed: the same zones give the same triangles
+    std::mt19937 rng(0x5eed);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    const int ROUND_MIN = 64;
+    auto by_key = [&keys](int a, int b) { return keys[a] < keys[b]; };
+    int end = len;
+    while (end > ROUND_MIN)
+    {
+        int begin = end / 2;
+        std::sort(order.begin() + begin, order.begin() + end, by_key);
+        end = begin;
+    }
+    std::sort(order.begin(), order.begin() + end, by_key);
 }
 
 /**
  * Delaunay test and edge remaking
  */
-inline void rend_triangle(int point, int face_rear, DCEL &edge1,
-                          face* faces, vertex* v, DCEL* edges)
+void Workspace::legalize(int point, int face_rear, int e1)
 {
-    if (edge1.fL == -1 || edge1.fR == -1)
+    if (fL[e1] == -1 || fR[e1] == -1)
         return;
-    
+
     /**
      *  Select edges from the incident triangle and adyacent triangle
      */
-    int face_next = (edge1.fL == face_rear) ? edge1.fR : edge1.fL;
-    bool edge1_cclockwise = (edge1.fL == face_rear) ? true : false;
-    
-    DCEL *edge3_rear = (edge1_cclockwise) ? &edges[edge1.eP] : &edges[edge1.eN];
-    bool edge3_rear_cclockwise = (edge3_rear->fL == face_rear) ? true : false;
-    
-    DCEL *edge2_rear = (edge3_rear_cclockwise) ? &edges[edge3_rear->eP] : &edges[edge3_rear->eN];
-    bool edge2_rear_cclockwise = (edge2_rear->fL == face_rear) ? true : false;
-    
-    DCEL *edge3_next = (!edge1_cclockwise) ? &edges[edge1.eP] : &edges[edge1.eN];
-    bool edge3_next_cclockwise = (edge3_next->fL == face_next) ? true : false;
-    
-    DCEL *edge2_next = (edge3_next_cclockwise) ? &edges[edge3_next->eP] : &edges[edge3_next->eN];
-    bool edge2_next_cclockwise = (edge2_next->fL == face_next) ? true : false;
+    int face_next = (fL[e1] == face_rear) ? fR[e1] : fL[e1];
+    bool e1_cclockwise = (fL[e1] == face_rear);
+
+    int e3_rear = (e1_cclockwise) ? eP[e1] : eN[e1];
+    bool e3_rear_cclockwise = (fL[e3_rear] == face_rear);
+
+    int e2_rear = (e3_rear_cclockwise) ? eP[e3_rear] : eN[e3_rear];
+    bool e2_rear_cclockwise = (fL[e2_rear] == face_rear);
+
+    int e3_next = (!e1_cclockwise) ? eP[e1] : eN[e1];
+    bool e3_next_cclockwise = (fL[e3_next] == face_next);
+
+    int e2_next = (e3_next_cclockwise) ? eP[e3_next] : eN[e3_next];
+    bool e2_next_cclockwise = (fL[e2_next] == face_next);
 
     /**
      * Select third point and make a circle and orientation tests
      */
-    Vector2 point1 = v[edge1.vB].getVector2();
-    Vector2 point2 = v[edge1.vE].getVector2();
-    int point3 = (edge3_next_cclockwise) ? edge3_next->vB : edge3_next->vE;
-    
-    bool circle_clockwise     = orientation2D( point1, point2, v[point3].getVector2()) < 0;
-    double circle_orientation = orientation25D(point1, point2, v[point3].getVector2(), v[point].getVector2());
-    
+    int point3 = (e3_next_cclockwise) ? vB[e3_next] : vE[e3_next];
+    const double p1[2] = {x[vB[e1]], y[vB[e1]]};
+    const double p2[2] = {x[vE[e1]], y[vE[e1]]};
+    const double p3[2] = {x[point3], y[point3]};
+    const double pt[2] = {x[point], y[point]};
+
+    double circle_orientation = orient2d(p1, p2, p3);
+    double circle_test = incircle(p1, p2, p3, pt);
+
     /**
      *  Modify edges structure with new edge and new links
      */
-    if ( !(circle_orientation < 0 && !circle_clockwise || circle_orientation > 0 && circle_clockwise) )
+    if ( !((circle_test > 0 && circle_orientation > 0) || (circle_test < 0 && circle_orientation < 0)) )
         return;
-    edges[edge1.e] = DCEL(edge1.e, point, point3, face_next, face_rear, edge2_rear->e, edge2_next->e);
-    DCEL *edge1_new = &edges[edge1.e];
+    set_edge(e1, point, point3, face_next, face_rear, e2_rear, e2_next);
 
-    faces[face_rear] = face(edge1_new->e);
-    faces[face_next] = face(edge1_new->e);
+    face_edge[face_rear] = e1;
+    face_edge[face_next] = e1;
 
-    edge2_rear->eP = (edge2_rear_cclockwise) ? edge3_next->e : edge2_rear->eP;
-    edge2_rear->eN = (edge2_rear_cclockwise) ? edge2_rear->eN : edge3_next->e;
-    edge2_rear->fL = (edge2_rear_cclockwise) ? face_next : edge2_rear->fL;
-    edge2_rear->fR = (edge2_rear_cclockwise) ? edge2_rear->fR : face_next;
+    if (e2_rear_cclockwise) { eP[e2_rear] = e3_next; fL[e2_rear] = face_next; }
+    else                    { eN[e2_rear] = e3_next; fR[e2_rear] = face_next; }
 
-    edge3_rear->eP = (edge3_rear_cclockwise) ? edge1_new->e : edge3_rear->eP;
-    edge3_rear->eN = (edge3_rear_cclockwise) ? edge3_rear->eN : edge1_new->e;
-    edge3_rear->fL = (edge3_rear_cclockwise) ? face_rear : edge3_rear->fL;
-    edge3_rear->fR = (edge3_rear_cclockwise) ? edge3_rear->fR : face_rear;
+    if (e3_rear_cclockwise) { eP[e3_rear] = e1; fL[e3_rear] = face_rear; }
+    else                    { eN[e3_rear] = e1; fR[e3_rear] = face_rear; }
 
-    edge2_next->eP = (edge2_next_cclockwise) ? edge3_rear->e : edge2_next->eP;
-    edge2_next->eN = (edge2_next_cclockwise) ? edge2_next->eN : edge3_rear->e;
-    edge2_next->fL = (edge2_next_cclockwise) ? face_rear : edge2_next->fL;
-    edge2_next->fR = (edge2_next_cclockwise) ? edge2_next->fR : face_rear;
+    if (e2_next_cclockwise) { eP[e2_next] = e3_rear; fL[e2_next] = face_rear; }
+    else                    { eN[e2_next] = e3_rear; fR[e2_next] = face_rear; }
 
-    edge3_next->eP = (edge3_next_cclockwise) ? edge1_new->e : edge3_next->eP;
-    edge3_next->eN = (edge3_next_cclockwise) ? edge3_next->eN : edge1_new->e;
-    edge3_next->fL = (edge3_next_cclockwise) ? face_next : edge3_next->fL;
-    edge3_next->fR = (edge3_next_cclockwise) ? edge3_next->fR : face_next;
+    if (e3_next_cclockwise) { eP[e3_next] = e1; fL[e3_next] = face_next; }
+    else                    { eN[e3_next] = e1; fR[e3_next] = face_next; }
 
     /**
      *  Adjacent triangles Delaunay correctness check and repairing if needed
      */
-    rend_triangle(point, ((edge3_next_cclockwise) ? edge3_next->fL : edge3_next->fR), *edge3_next, faces, v, edges);
-    rend_triangle(point, ((edge2_next_cclockwise) ? edge2_next->fL : edge2_next->fR), *edge2_next, faces, v, edges);
+    legalize(point, (e3_next_cclockwise) ? fL[e3_next] : fR[e3_next], e3_next);
+    legalize(point, (e2_next_cclockwise) ? fL[e2_next] : fR[e2_next], e2_next);
+}
+
+void Workspace::face_ring(int f, int* v, int* e) const
+{
+    e[0] = face_edge[f];
+    bool e1_cclockwise = (fL[e[0]] == f);
+    e[2] = (e1_cclockwise) ? eP[e[0]] : eN[e[0]];
+    bool e3_cclockwise = (fL[e[2]] == f);
+    e[1] = (e3_cclockwise) ? eP[e[2]] : eN[e[2]];
+    for (int i = 0; i < 3; ++i)
+        v[i] = (fL[e[i]] == f) ? vB[e[i]] : vE[e[i]];
+}
+
+void Workspace::set_face(int f, const int* v, const int* e)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        int prev = e[(i + 2) % 3];
+        if (vB[e[i]] == v[i]) { fL[e[i]] = f; eP[e[i]] = prev; }
+        else                  { fR[e[i]] = f; eN[e[i]] = prev; }
+    }
+    face_edge[f] = e[0];
 }
 
 /**
- *  Progressive triangulation function of the points placed in 'ps' array
+ *  The point lies on the edge (e) of the face (f): split both triangles of the edge,
+ *  a 1 -> 3 split would leave a zero-area triangle that legalize() can't flip.
+ *  The triangles (a, b, c) of (f) and (b, a, d) of the other face become
+ *  (a, p, c), (p, b, c), (p, a, d) and (b, p, d).
  */
-std::shared_ptr<Result> triangulate(const Vector3 *ps, int len)
+void Workspace::split_edge(int point, int f, int e)
+{
+    int v[3], fe[3];
+    face_ring(f, v, fe);
+    int k = (fe[0] == e) ? 0 : (fe[1] == e) ? 1 : 2;
+    const int a = v[k], b = v[(k + 1) % 3], c = v[(k + 2) % 3];
+    const int e_bc = fe[(k + 1) % 3], e_ca = fe[(k + 2) % 3];
+
+    const int g = (fL[e] == f) ? fR[e] : fL[e];
+    face_ring(g, v, fe);
+    k = (fe[0] == e) ? 0 : (fe[1] == e) ? 1 : 2;
+    const int d = v[(k + 2) % 3];
+    const int e_ad = fe[(k + 1) % 3], e_db = fe[(k + 2) % 3];
+
+    const int E = edges_used;
+    const int F = faces_used;
+    set_edge(e,   a,     point, -1, -1, -1, -1);
+    set_edge(E,   point, b,     -1, -1, -1, -1);
+    set_edge(E+1, point, c,     -1, -1, -1, -1);
+    set_edge(E+2, point, d,     -1, -1, -1, -1);
+
+    { const int fv[3] = {a, point, c}, fs[3] = {e, E+1, e_ca};   set_face(f, fv, fs); }
+    { const int fv[3] = {point, b, c}, fs[3] = {E, e_bc, E+1};   set_face(F, fv, fs); }
+    { const int fv[3] = {point, a, d}, fs[3] = {e, e_ad, E+2};   set_face(g, fv, fs); }
+    { const int fv[3] = {b, point, d}, fs[3] = {E, E+2, e_db};   set_face(F+1, fv, fs); }
+
+    legalize(point, f, e_ca);
+    legalize(point, F, e_bc);
+    legalize(point, g, e_ad);
+    legalize(point, F+1, e_db);
+}
+
+int Workspace::triangulate(const glm::ivec2* ps, int len)
+{
+    points_num = std::max(0, len);
+    x.resize(points_num + 3);
+    y.resize(points_num + 3);
+    for (int i = 0; i < points_num; ++i)
+    {
+        x[3 + i] = (float)ps[i].x;
+        y[3 + i] = (float)ps[i].y;
+    }
+    run();
+    return faces_used;
+}
+
+int Workspace::triangulate(const glm::vec2* ps, int len)
+{
+    points_num = std::max(0, len);
+    x.resize(points_num + 3);
+    y.resize(points_num + 3);
+    for (int i = 0; i < points_num; ++i)
+    {
+        x[3 + i] = ps[i].x;
+        y[3 + i] = ps[i].y;
+    }
+    run();
+    return faces_used;
+}
+
+/**
+ *  Progressive triangulation of the vertices 3..points_num+2
+ */
+void Workspace::run()
 {
     /**
      *  Begining
      */
-    int n = len;
-    std::shared_ptr<Result> res = std::make_shared<Result>(n);
-    face* faces = &(res->faces[0]);
-    vertex* vertices = &(res->vertices[0]);
-    DCEL* edges = &(res->edges[0]);;
+    int n = points_num;
+    face_edge.assign(2 * n + 1, -1);
+    vB.assign(3 * n + 3, -1);
+    vE.assign(3 * n + 3, -1);
+    fL.assign(3 * n + 3, -1);
+    fR.assign(3 * n + 3, -1);
+    eP.assign(3 * n + 3, -1);
+    eN.assign(3 * n + 3, -1);
+    faces_used = 0;
+    edges_used = 0;
+    inside.clear();
+    if (n <= 0)
+        return;
 
     /**
      *  Initialization
      */
-    Vector3 p1, p2, p3;
-    enclosingTriangle(ps, len, p1, p2, p3);
-    
-    vertices[0].p = p1;
-    vertices[1].p = p2;
-    vertices[2].p = p3;
-    
+    enclosingTriangle(x, y, n);
+
     // infinite = -1
-    edges[0].e  =  0;
-    edges[0].vB =  0;
-    edges[0].vE =  1;
-    edges[0].fL =  0;
-    edges[0].fR = -1; // No face
-    edges[0].eP =  2;
-    edges[0].eN =  1;
-    edges[1].e  =  1;
-    edges[1].vB =  1;
-    edges[1].vE =  2;
-    edges[1].fL =  0;
-    edges[1].fR = -1;
-    edges[1].eP =  0;
-    edges[1].eN =  2;
-    edges[2].eP =  1;
-    edges[2].e  =  2;
-    edges[2].vB =  2;
-    edges[2].vE =  0;
-    edges[2].fL =  0;
-    edges[2].fR = -1;
-    edges[2].eN =  0;
-    
-    faces[0] = face(0);
-    
-    int faces_pointer    = 1;
-    int edges_pointer    = 3;
-    int vertices_pointer = 3;
-    
+    set_edge(0, 0, 1, 0, -1, 2, 1);
+    set_edge(1, 1, 2, 0, -1, 0, 2);
+    set_edge(2, 2, 0, 0, -1, 1, 0);
+    face_edge[0] = 0;
+
+    faces_used = 1;
+    edges_used = 3;
+
     /**
      * Main loop
      */
-    
-    Vector3 vertex1, vertex2, vertex3, pivot;
-    DCEL *edge1 = 0, *edge2 = 0, *edge3 = 0;
-    bool edge1_cclockwise = false, edge2_cclockwise = false,
-            edge3_cclockwise = false, found = false;
-    int point1 = 0, point2 = 0, point3 = 0, walker = 0, rear = 0;
-    
-    pivot = vertices[edges[0].vB].p;
-    
-    for (int i = 0; i < n; ++i)
+
+    brioOrder(x, y, n, order, keys);
+
+    int e1 = 0, e2 = 0, e3 = 0;
+    bool e1_cclockwise = false, e2_cclockwise = false,
+            e3_cclockwise = false, found = false;
+    int point1 = 0, point2 = 0, point3 = 0, walker = 0, came = -1;
+    uint32_t rnd = 2463534242u;
+
+    for (int k = 0; k < n; ++k)
     {
-        rear   = -1;
-        walker = edges[0].fL;
-        found  = false;
+        const int vid = order[k];
+        const double p[2] = {x[vid], y[vid]};
 
-        /** Triangle location algorithm */
-        while (!found)
+        /** Triangle location: remembering stochastic walk from the last triangle */
+        came  = -1;
+        found = false;
+        while (walker >= 0 && !found)
         {
-            edge1 = &edges[faces[walker].idx];
-            edge1_cclockwise = (edge1->fL == walker) ? true : false;
+            e1 = face_edge[walker];
+            e1_cclockwise = (fL[e1] == walker);
 
-            edge3 = (edge1_cclockwise) ? &edges[edge1->eP] : &edges[edge1->eN];
-            edge3_cclockwise = (edge3->fL == walker) ? true : false;
+            e3 = (e1_cclockwise) ? eP[e1] : eN[e1];
+            e3_cclockwise = (fL[e3] == walker);
 
-            edge2 = (edge3_cclockwise) ? &edges[edge3->eP] : &edges[edge3->eN];
-            edge2_cclockwise = (edge2->fL == walker) ? true : false;
+            e2 = (e3_cclockwise) ? eP[e3] : eN[e3];
+            e2_cclockwise = (fL[e2] == walker);
 
-            point1 = (edge1_cclockwise) ? edge1->vB : edge1->vE;
-            point2 = (edge2_cclockwise) ? edge2->vB : edge2->vE;
-            point3 = (edge3_cclockwise) ? edge3->vB : edge3->vE;
+            point1 = (e1_cclockwise) ? vB[e1] : vE[e1];
+            point2 = (e2_cclockwise) ? vB[e2] : vE[e2];
+            point3 = (e3_cclockwise) ? vB[e3] : vE[e3];
 
-            vertex1 = vertices[point1].p;
-            vertex2 = vertices[point2].p;
-            vertex3 = vertices[point3].p;
+            const int sides[3] = {e1, e2, e3};
+            const int from[3] = {point1, point2, point3};
+            const int to[3] = {point2, point3, point1};
 
-            if (isInside(vertex1, vertex2, vertex3, ps[i]))
+            /** Cross an edge having the point on its other side, starting from a random one */
+            rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+            int next = -1;
+            for (int j = 0; j < 3 && next < 0; ++j)
+            {
+                int s = (int)((rnd + j) % 3);
+                if (sides[s] == came)
+                    continue;
+                const double a[2] = {x[from[s]], y[from[s]]};
+                const double b[2] = {x[to[s]], y[to[s]]};
+                if (orient2d(a, b, p) < 0)
+                    next = sides[s];
+            }
+
+            if (next < 0)
             {
                 found = true;
             }
             else
             {
-                /** If not found then look for segment-segment intersection */
-                int aux1 = (edge1->fL == rear || edge1->fR == rear) ? 0 : intersects(vertex1, vertex2, ps[i], pivot);
-                int aux2 = (edge2->fL == rear || edge2->fR == rear) ? 0 : intersects(vertex2, vertex3, ps[i], pivot);
-                int aux3 = (edge3->fL == rear || edge3->fR == rear) ? 0 : intersects(vertex3, vertex1, ps[i], pivot);
-                int next = (aux1 == 2)*edge1->e | (aux2 == 2)*edge2->e | (aux3 == 2)*edge3->e;
+                came   = next;
+                walker = (walker == fL[next]) ? fR[next] : fL[next];
+            }
+        }
 
-                if (next == 0)
-                {
-                    /** If not segment-segment then randomize the next step (if valid) */
-                    int random;
-                    next = -1;
-
-                    while (next == -1)
-                    {
-                        random = rand()%3;
-                        if (aux1 == 1 && random == 0) next = edge1->e;
-                        if (aux2 == 1 && random == 1) next = edge2->e;
-                        if (aux3 == 1 && random == 2) next = edge3->e;
-                    }
-                }
+        if (!found)
+        {/** Outside the enclosing triangle: can't happen but for NaN input */
+            walker = 0;
+            continue;
+        }
+        if ((x[point1] == p[0] && y[point1] == p[1]) || (x[point2] == p[0] && y[point2] == p[1])
+                || (x[point3] == p[0] && y[point3] == p[1]))
+        {/** Duplicate point: left unconnected */
+            continue;
+        }
 
-                rear   = walker;
-                walker = (walker == edges[next].fL) ? edges[next].fR : edges[next].fL;
-            }
+        /** On an edge: 2 -> 4 triangles */
+        const int corners[4] = {point1, point2, point3, point1};
+        const int sides[3] = {e1, e2, e3};
+        int on_edge = -1;
+        for (int j = 0; j < 3 && on_edge < 0; ++j)
+        {
+            const double a[2] = {x[corners[j]], y[corners[j]]};
+            const double b[2] = {x[corners[j + 1]], y[corners[j + 1]]};
+            if (0 == orient2d(a, b, p))
+                on_edge = sides[j];
+        }
+        if (on_edge >= 0)
+        {
+            split_edge(vid, walker, on_edge);
+            edges_used += 3;
+            faces_used += 2;
+            continue;
         }
 
         /** Creating 3 new triangles inside a triangle */
-        vertices[vertices_pointer] = vertex(ps[i]);
-
-        edges[edges_pointer]   = DCEL(edges_pointer,   vertices_pointer, point1,          walker, faces_pointer+1, edges_pointer+1, edge3->e);
-        edges[edges_pointer+1] = DCEL(edges_pointer+1, vertices_pointer, point2,   faces_pointer,          walker, edges_pointer+2, edge1->e);
-        edges[edges_pointer+2] = DCEL(edges_pointer+2, vertices_pointer, point3, faces_pointer+1,   faces_pointer,   edges_pointer, edge2->e);
-
-        edge1->eP = (edge1_cclockwise) ? edges_pointer : edge1-> eP;
-        edge1->eN = (edge1_cclockwise) ? edge1->eN : edges_pointer;
-        edge2->eP = (edge2_cclockwise) ? edges_pointer+1 : edge2->eP;
-        edge2->eN = (edge2_cclockwise) ? edge2->eN : edges_pointer+1;
-        edge2->fL = (edge2_cclockwise) ? faces_pointer : edge2->fL;
-        edge2->fR = (edge2_cclockwise) ? edge2->fR : faces_pointer;
-        edge3->eP = (edge3_cclockwise) ? edges_pointer+2 : edge3->eP;
-        edge3->eN = (edge3_cclockwise) ? edge3->eN : edges_pointer+2;
-        edge3->fL = (edge3_cclockwise) ? faces_pointer+1 : edge3->fL;
-        edge3->fR = (edge3_cclockwise) ? edge3->fR : faces_pointer+1;
-
-        faces[faces_pointer]   = face(edge2->e);
-        faces[faces_pointer+1] = face(edge3->e);
+        const int E = edges_used;
+        const int F = faces_used;
+        set_edge(E,   vid, point1, walker,    F+1,    E+1, e3);
+        set_edge(E+1, vid, point2,      F, walker,    E+2, e1);
+        set_edge(E+2, vid, point3,    F+1,      F,      E, e2);
+
+        if (e1_cclockwise) { eP[e1] = E; }
+        else               { eN[e1] = E; }
+        if (e2_cclockwise) { eP[e2] = E+1; fL[e2] = F; }
+        else               { eN[e2] = E+1; fR[e2] = F; }
+        if (e3_cclockwise) { eP[e3] = E+2; fL[e3] = F+1; }
+        else               { eN[e3] = E+2; fR[e3] = F+1; }
+
+        face_edge[F]   = e2;
+        face_edge[F+1] = e3;
 
         /** Delaunay correctness check and repairing if needed  */
-        rend_triangle(vertices_pointer, walker, *edge1, faces, vertices, edges);
-        rend_triangle(vertices_pointer, faces_pointer, *edge2, faces, vertices, edges);
-        rend_triangle(vertices_pointer, faces_pointer+1, *edge3, faces, vertices, edges);
+        legalize(vid, walker, e1);
+        legalize(vid, F, e2);
+        legalize(vid, F+1, e3);
 
         /* Empty element pointer */
-        edges_pointer += 3;
-        faces_pointer += 2;
-        vertices_pointer += 1;
+        edges_used += 3;
+        faces_used += 2;
+    }
+}
+
+static inline double orient(const std::vector<float>& x, const std::vector<float>& y, int a, int b, int c)
+{
+    const double pa[2] = {x[a], y[a]};
+    const double pb[2] = {x[b], y[b]};
+    const double pc[2] = {x[c], y[c]};
+    return orient2d(pa, pb, pc);
+}
+
+/**
+ *  Rotate the face's ring so that (a) comes first: (a, u, w), e[0] = a-u, e[1] = u-w, e[2] = w-a.
+ */
+static inline void ringFrom(int a, int* v, int* e)
+{
+    while (v[0] != a)
+    {
+        std::rotate(v, v + 1, v + 3);
+        std::rotate(e, e + 1, e + 3);
+    }
+}
+
+/**
+ *  Flip the diagonal of the quadrilateral of the faces of (e):
+ *  (a, b, c) and (b, a, d) become (d, b, c) and (c, a, d).
+ */
+void Workspace::flip(int e)
+{
+    const int f = fL[e], g = fR[e];
+    int v[3], fe[3], w[3], ge[3];
+    face_ring(f, v, fe);
+    ringFrom(vB[e], v, fe);
+    face_ring(g, w, ge);
+    ringFrom(vE[e], w, ge);
+    const int a = v[0], b = v[1], c = v[2], d = w[2];
+    const int e_bc = fe[1], e_ca = fe[2], e_ad = ge[1], e_db = ge[2];
+
+    vB[e] = d;
+    vE[e] = c;
+    { const int fv[3] = {d, b, c}, fs[3] = {e_db, e_bc, e};   set_face(f, fv, fs); }
+    { const int fv[3] = {c, a, d}, fs[3] = {e_ca, e_ad, e};   set_face(g, fv, fs); }
+    if (vertex_edge[a] == e) vertex_edge[a] = e_ca;
+    if (vertex_edge[b] == e) vertex_edge[b] = e_bc;
+}
+
+/**
+ *  The edge a-b, -1 if there is none. Walks the faces around (a).
+ */
+int Workspace::edge_between(int a, int b) const
+{
+    int e = vertex_edge[a];
+    int f = (fL[e] >= 0) ? fL[e] : fR[e];
+    int v[3], fe[3];
+    for (int start = f, guard = faces_used; guard > 0; --guard)
+    {
+        face_ring(f, v, fe);
+        ringFrom(a, v, fe);
+        if (v[1] == b) return fe[0];
+        if (v[2] == b) return fe[2];
+        f = (fL[fe[0]] == f) ? fR[fe[0]] : fL[fe[0]];
+        if (f < 0 || f == start)
+            break;
+    }
+    return -1;
+}
+
+/**
+ *  Make the segment a-b, or its part up to the first vertex on it, an edge of the triangulation:
+ *  the edges crossing it are collected along the segment, then flipped until none crosses it.
+ *  @return the end of the recovered part, -1 if it crosses the outline's edges.
+ */
+int Workspace::recover_edge(int a, int b)
+{
+    //the face around (a) the segment leaves through
+    int e = vertex_edge[a];
+    int f = (fL[e] >= 0) ? fL[e] : fR[e];
+    int v[3], fe[3];
+    int right = -1, left = -1, cross = -1;
+    for (int start = f, guard = faces_used; guard > 0 && cross < 0; --guard)
+    {
+        face_ring(f, v, fe);
+        ringFrom(a, v, fe);
+        for (int i = 1; i < 3; ++i)
+        {
+            const int t = v[i];
+            const double dot = ((double)x[t] - x[a]) * ((double)x[b] - x[a])
+                             + ((double)y[t] - y[a]) * ((double)y[b] - y[a]);
+            if (t == b || (0 == orient(x, y, a, b, t) && dot > 0))
+            {
+                const int ab = (1 == i) ? fe[0] : fe[2];
+                constraint[ab] = (uint8_t)(((constraint[ab] & 1) ^ 1) | 2);
+                return t;
+            }
+        }
+        if (orient(x, y, a, b, v[1]) < 0 && orient(x, y, a, b, v[2]) > 0)
+        {
+            right = v[1];
+            left = v[2];
+            cross = fe[1];
+            break;
+        }
+        f = (fL[fe[0]] == f) ? fR[fe[0]] : fL[fe[0]];
+        if (f < 0 || f == start)
+            break;
+    }
+    if (cross < 0)
+        return -1;
+
+    //the crossed edges up to (b) or a vertex on the segment
+    crossing.clear();
+    int end = -1;
+    while (end < 0)
+    {
+        if (constraint[cross] & 2)
+            return -1;
+        crossing.push_back(cross);
+        f = (fL[cross] == f) ? fR[cross] : fL[cross];
+        if (f < 0)
+            return -1;
+        face_ring(f, v, fe);
+        ringFrom(left, v, fe);//(left, right, t)
+        const int t = v[2];
+        const double o = orient(x, y, a, b, t);
+        if (t == b || 0 == o)
+        {
+            end = t;
+        }
+        else if (o < 0)
+        {
+            cross = fe[2];
+            right = t;
+        }
+        else
+        {
+            cross = fe[1];
+            left = t;
+        }
+    }
+
+    //flip the convex quadrilaterals, the new diagonals still crossing go back to the queue
+    size_t stall = 0;
+    for (size_t head = 0; head < crossing.size(); ++head)
+    {
+        e = crossing[head];
+        int w[3], ge[3];
+        face_ring(fL[e], v, fe);
+        ringFrom(vB[e], v, fe);
+        face_ring(fR[e], w, ge);
+        ringFrom(vE[e], w, ge);
+        const int c = v[2], d = w[2];
+        const double oB = orient(x, y, c, d, vB[e]);
+        const double oE = orient(x, y, c, d, vE[e]);
+        if (!((oB > 0 && oE < 0) || (oB < 0 && oE > 0)))
+        {
+            if (++stall > crossing.size() - head)
+                return -1;
+            crossing.push_back(e);
+            continue;
+        }
+        stall = 0;
+        flip(e);
+        if (c != a && c != end && d != a && d != end)
+        {
+            const double oc = orient(x, y, a, end, c), od = orient(x, y, a, end, d);
+            if ((oc > 0 && od < 0) || (oc < 0 && od > 0))
+                crossing.push_back(e);
+        }
+    }
+
+    e = edge_between(a, end);
+    if (e < 0)
+        return -1;
+    constraint[e] = (uint8_t)(((constraint[e] & 1) ^ 1) | 2);
+    return end;
+}
+
+/**
+ *  Faces inside the outline: a flood fill from the faces of the enclosing triangle,
+ *  the parity changes across the outline's edges.
+ */
+void Workspace::mark_inside()
+{
+    //0: not reached, 1: outside, 2: inside
+    inside.assign(faces_used, 0);
+    crossing.clear();
+    int v[3], fe[3];
+    for (int f = 0; f < faces_used; ++f)
+    {
+        if (face_edge[f] < 0)
+            continue;
+        face_ring(f, v, fe);
+        if (v[0] <= 2 || v[1] <= 2 || v[2] <= 2)
+        {
+            inside[f] = 1;
+            crossing.push_back(f);
+        }
     }
-    
-    /** Destroying every enclosing triangle edge (-1 to vB) */
-    for(int i = 0; i < edges_pointer; ++i)
+    for (size_t head = 0; head < crossing.size(); ++head)
     {
-        edge1  = &edges[i];
-        point1 = edge1->vB;
-        point2 = edge1->vE;
+        const int f = crossing[head];
+        face_ring(f, v, fe);
+        for (int i = 0; i < 3; ++i)
+        {
+            const int g = (fL[fe[i]] == f) ? fR[fe[i]] : fL[fe[i]];
+            if (g < 0 || 0 != inside[g])
+                continue;
+            inside[g] = (constraint[fe[i]] & 1) ? (uint8_t)(3 - inside[f]) : inside[f];
+            crossing.push_back(g);
+        }
+    }
+    for (uint8_t& in : inside)
+        in = (2 == in) ? 1 : 0;
+}
 
-        if (point1 == 0 || point2 == 0) edge1->vB = -1;
-        if (point1 == 1 || point2 == 1) edge1->vB = -1;
-        if (point1 == 2 || point2 == 2) edge1->vB = -1;
+int Workspace::triangulate_outline(const glm::ivec2* ps, int len)
+{
+    triangulate(ps, len);
+    const int n = points_num;
+    if (n < 3)
+    {
+        inside.assign(faces_used, 0);
+        return 0;
+    }
+
+    vertex_edge.assign(n + 3, -1);
+    for (int e = 0; e < edges_used; ++e)
+    {
+        vertex_edge[vB[e]] = e;
+        vertex_edge[vE[e]] = e;
+    }
+    //the duplicates are unconnected: the outline goes through their connected twin
+    std::vector<int>& twin = order;
+    twin.resize(n + 3);
+    for (int i = 0; i < n + 3; ++i)
+        twin[i] = i;
+    bool dups = false;
+    for (int i = 3; i < n + 3 && !dups; ++i)
+        dups = vertex_edge[i] < 0;
+    if (dups)
+    {
+        std::vector<int> by_xy(n);
+        for (int i = 0; i < n; ++i)
+            by_xy[i] = 3 + i;
+        auto by_position = [this](int a, int b)
+        {
+            if (x[a] != x[b]) return x[a] < x[b];
+            if (y[a] != y[b]) return y[a] < y[b];
+            return vertex_edge[a] > vertex_edge[b];//the connected one first
+        };
+        std::sort(by_xy.begin(), by_xy.end(), by_position);
+        for (int i = 1; i < n; ++i)
+        {
+            const int p = by_xy[i - 1], q = by_xy[i];
+            if (x[p] == x[q] && y[p] == y[q])
+                twin[q] = twin[p];
+        }
+    }
+
+    constraint.assign(edges_used, 0);
+    int skipped = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        int a = twin[3 + i];
+        const int b = twin[3 + (i + 1) % n];
+        while (a != b && a >= 0)
+            a = recover_edge(a, b);
+        if (a < 0)
+            ++skipped;
     }
+    mark_inside();
+    if (skipped > 0)
+    {//the faces cross the skipped edges: the parity is wrong beyond them, test the centroids
+        int v[3], fe[3];
+        for (int f = 0; f < faces_used; ++f)
+        {
+            if (face_edge[f] >= 0)
+            {
+                face_ring(f, v, fe);
+                const double cx = ((double)x[v[0]] + x[v[1]] + x[v[2]]) / 3.0;
+                const double cy = ((double)y[v[0]] + y[v[1]] + y[v[2]]) / 3.0;
+                bool in = false;
+                for (int i = 3, j = n + 2; i < n + 3; j = i++)
+                {
+                    if ((y[i] > cy) != (y[j] > cy)
+                            && cx < x[i] + (cy - y[i]) * (x[j] - x[i]) / (y[j] - y[i]))
+                        in = !in;
+                }
+                inside[f] = in ? 1 : 0;
+            }
+        }
+    }
+    return skipped;
+}
+
+bool Workspace::face_vertices(int f, int& a, int& b, int& c) const
+{
+    if (f < 0 || f >= faces_used || face_edge[f] < 0)
+        return false;
+    int e1 = face_edge[f];
+    bool e1_cclockwise = (fL[e1] == f);
+    int e3 = (e1_cclockwise) ? eP[e1] : eN[e1];
+    bool e3_cclockwise = (fL[e3] == f);
+    int e2 = (e3_cclockwise) ? eP[e3] : eN[e3];
+    bool e2_cclockwise = (fL[e2] == f);
+    a = (e1_cclockwise) ? vB[e1] : vE[e1];
+    b = (e2_cclockwise) ? vB[e2] : vE[e2];
+    c = (e3_cclockwise) ? vB[e3] : vE[e3];
+    return a > 2 && b > 2 && c > 2;
+}
+
+void Workspace::to_result(Result& res) const
+{
+    int n = points_num;
+    res.setup(n);
+    for (int i = 0; i < n + 3; ++i)
+        res.vertices[i] = vertex(Vector3(x[i], y[i], 0.0));
+    for (int f = 0; f < (int)face_edge.size(); ++f)
+        res.faces[f] = face(face_edge[f]);
+    for (int e = 0; e < edges_used; ++e)
+    {
+        res.edges[e] = DCEL(e, vB[e], vE[e], fL[e], fR[e], eP[e], eN[e]);
+
+        /** Destroying every enclosing triangle edge (-1 to vB) */
+        if (vB[e] <= 2 || vE[e] <= 2)
+            res.edges[e].vB = -1;
+    }
+}
+
+/**
+ *  Progressive triangulation function of the points placed in 'ps' array
+ */
+std::shared_ptr<Result> triangulate(const Vector3 *ps, int len)
+{
+    std::vector<glm::vec2> pts(std::max(0, len));
+    for (int i = 0; i < len; ++i)
+        pts[i] = glm::vec2((float)ps[i][X], (float)ps[i][Y]);
+
+    Workspace ws;
+    ws.triangulate(pts.data(), len);
+    std::shared_ptr<Result> res = std::make_shared<Result>();
+    ws.to_result(*res);
     return res;
 }
 
 }//namespae JVa
-
@@ -2,10 +2,14 @@
   Origin https://github.com/JVanDamme/ProgressiveDelaunay
   Modified.
  */
+#ifndef JVA_TRIANGULATION_H
+#define JVA_TRIANGULATION_H
+
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 namespace JVa
 {
@@ -88,8 +92,97 @@ public:
 };
 
 /**
- *  Progressive triangulation function of the points placed in 'ps' array
+ *  Reusable triangulation state: the arrays keep their capacity between the calls,
+ *  so re-triangulating a zone on every edit does not allocate.
+ *  Coordinates are 2D floats (exact for the pixel grids), the DCEL is stored
+ *  as a structure of arrays: the walks read a few ints per step.
+ *  Vertices 0..2 are the enclosing triangle, ps[i] is vertex 3 + i.
+ *  Not thread-safe: one per thread or per zone editor.
+ */
+class Workspace
+{
+public:
+    /** Triangulate the points.
+     * @return the number of triangles (including the ones touching the enclosing triangle).*/
+    int triangulate(const glm::ivec2* ps, int len);
+    int triangulate(const glm::vec2* ps, int len);
+
+    /** Triangulate the closed outline ps[0] - ps[1] - ... - ps[len - 1] - ps[0]:
+     * the points are triangulated, then the outline's edges are recovered by flips (Sloan),
+     * the vertices exactly on an edge split it. The faces inside the outline (even-odd)
+     * are marked in (inside). A self-intersecting outline is not split at the crossings:
+     * an edge crossing the already recovered ones is skipped, then the faces are classified
+     * by their centroids, approximate next to the crossings.
+     * @return the number of the skipped edges.*/
+    int triangulate_outline(const glm::ivec2* ps, int len);
+
+    /** Vertices of the face, counterclockwise.
+     * @return FALSE if (f) is unused or touches the enclosing triangle.*/
+    bool face_vertices(int f, int& a, int& b, int& c) const;
+
+    /** Copy to the legacy layout, the enclosing triangle's edges get vB = -1.*/
+    void to_result(Result& res) const;
+
+    int points_num = 0;
+    int faces_used = 0;
+    int edges_used = 0;
+
+    //vertices
+    std::vector<float> x;
+    std::vector<float> y;
+
+    //faces: an edge of the face
+    std::vector<int> face_edge;
+
+    //edges, see DCEL
+    std::vector<int> vB;
+    std::vector<int> vE;
+    std::vector<int> fL;
+    std::vector<int> fR;
+    std::vector<int> eP;
+    std::vector<int> eN;
+
+    /** After triangulate_outline(): per face, 1 if inside the outline; empty after triangulate().*/
+    std::vector<uint8_t> inside;
+
+    /** Vertices and edges of the face, counterclockwise: e[i] goes v[i] -> v[(i + 1) % 3].*/
+    void face_ring(int f, int* v, int* e) const;
+
+private:
+    void run();
+    void legalize(int point, int face_rear, int e1);
+    /** Link the face to its edges, (v) and (e) as in face_ring().*/
+    void set_face(int f, const int* v, const int* e);
+    /** Insert the point on the edge (e) of the face (f): 2 -> 4 triangles.*/
+    void split_edge(int point, int f, int e);
+
+    //outlines
+    void flip(int e);
+    int edge_between(int a, int b) const;
+    int recover_edge(int a, int b);
+    void mark_inside();
+
+    std::vector<int> vertex_edge;//< an edge of the vertex, -1 for the duplicates
+    std::vector<uint8_t> constraint;//< per edge: 1 odd times on the outline, 2 on the outline
+    std::vector<int> crossing;
+    void set_edge(int e, int ivB, int ivE, int ifL, int ifR, int ieP, int ieN)
+    {
+        vB[e] = ivB; vE[e] = ivE; fL[e] = ifL; fR[e] = ifR; eP[e] = ieP; eN[e] = ieN;
+    }
+
+    std::vector<int> order;
+    std::vector<uint64_t> keys;
+};
+
+/**
+ *  Progressive triangulation function of the points placed in 'ps' array.
+ *  The points are inserted in BRIO order along a Hilbert curve, each location walk
+ *  starts from the last created triangle: O(n log n) expected.
+ *  ps[i] is stored as vertices[3 + i], the duplicates stay unconnected.
+ *  Runs on a Workspace: the coordinates are rounded to floats.
  */
 std::shared_ptr<Result> triangulate(const Vector3* ps, int len);
 
 }//JVa
+
+#endif // JVA_TRIANGULATION_H
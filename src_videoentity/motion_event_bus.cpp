@@ -0,0 +1,186 @@
+#include "motion_event_bus.h"
+
+#include <zmq.h>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace ZMBEntities {
+
+bool ParseMotionEventBatch(const void* data, size_t len,
+                           MotionEventBatchHeader& header, std::vector<MotionEvent>& events)
+{
+    events.clear();
+    if (nullptr == data || len < sizeof(MotionEventBatchHeader))
+        return false;
+
+    ::memcpy(&header, data, sizeof(header));
+    if (MotionEventBatchHeader::VERSION != header.version
+        || len != sizeof(header) + header.count * sizeof(MotionEvent))
+        return false;
+
+    events.resize(header.count);
+    ::memcpy(events.data(), (const char*)data + sizeof(header), header.count * sizeof(MotionEvent));
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+MotionEventBus::MotionEventBus()
+    : zcontext(nullptr), zsocket(nullptr), pending_limit(0), should_run(false), sequence(0)
+{
+
+}
+
+MotionEventBus::~MotionEventBus()
+{
+    close();
+}
+
+bool MotionEventBus::open(const MotionEventBusParams& params)
+{
+    close();
+    bus_params = params;
+    if (0 == bus_params.max_batch || bus_params.max_batch > UINT16_MAX)
+        bus_params.max_batch = UINT16_MAX;
+
+    zcontext = zmq_ctx_new();
+    zsocket = zmq_socket(zcontext, ZMQ_PUB);
+    int linger = 0;
+    zmq_setsockopt(zsocket, ZMQ_SNDHWM, &bus_params.send_hwm, sizeof(bus_params.send_hwm));
+    zmq_setsockopt(zsocket, ZMQ_LINGER, &linger, sizeof(linger));
+
+    if (0 != zmq_bind(zsocket, bus_params.endpoint.c_str()))
+    {
+        std::cerr << "MotionEventBus: can't bind " << bus_params.endpoint
+                  << ": " << zmq_strerror(zmq_errno()) << "\n";
+        zmq_close(zsocket);
+        zmq_ctx_term(zcontext);
+        zsocket = zcontext = nullptr;
+        return false;
+    }
+
+    pending.reserve(bus_params.max_batch);
+    pending_limit = (size_t)std::max(1, bus_params.send_hwm) * bus_params.max_batch;
+    wire_buffer.reserve(sizeof(MotionEventBatchHeader) + bus_params.max_batch * sizeof(MotionEvent));
+    should_run = true;
+    flusher = std::thread([this]() { run(); });
+    return true;
+}
+
+void MotionEventBus::close()
+{
+    {
+        std::unique_lock<std::mutex> lk(pending_mutex);
+        should_run = false;
+    }
+    pending_cond.notify_all();
+    if (flusher.joinable())
+        flusher.join();
+
+    if (nullptr != zsocket)
+    {
+        zmq_close(zsocket);
+        zsocket = nullptr;
+    }
+    if (nullptr != zcontext)
+    {
+        zmq_ctx_term(zcontext);
+        zcontext = nullptr;
+    }
+}
+
+void MotionEventBus::publish(const MotionEvent& event)
+{
+    bool is_full = false;
+    {
+        std::unique_lock<std::mutex> lk(pending_mutex);
+        if (!should_run)
+        {//not open or closed: nobody would flush it
+            counters.refused.fetch_add(1);
+            return;
+        }
+        if (bus_params.coalesce)
+        {
+            auto it = pending_index.find(event.key());
+            if (it != pending_index.end())
+            {
+                MotionEvent& prev(pending[it->second]);
+                if (prev.type == event.type && prev.state == event.state)
+                {//same state: keep the latest values only
+                    prev.ts_usec = event.ts_usec;
+                    prev.pixel_ratio = event.pixel_ratio;
+                    counters.published.fetch_add(1);
+                    counters.coalesced.fetch_add(1);
+                    return;
+                }
+            }
+        }
+        if (pending.size() >= pending_limit)
+        {//the flusher is stuck: don't grow without a bound
+            counters.refused.fetch_add(1);
+            return;
+        }
+        counters.published.fetch_add(1);
+        if (bus_params.coalesce)
+            pending_index[event.key()] = pending.size();
+        pending.push_back(event);
+        is_full = pending.size() >= bus_params.max_batch;
+    }
+    if (is_full)
+        pending_cond.notify_one();
+}
+
+void MotionEventBus::run()
+{
+    std::vector<MotionEvent> batch;
+    batch.reserve(bus_params.max_batch);
+    const std::chrono::milliseconds period(bus_params.flush_interval_ms);
+
+    std::unique_lock<std::mutex> lk(pending_mutex);
+    while (should_run || !pending.empty())
+    {
+        pending_cond.wait_for(lk, period, [this]()
+        { return !should_run || pending.size() >= bus_params.max_batch; });
+
+        if (pending.empty())
+            continue;
+
+        batch.swap(pending);
+        pending_index.clear();
+        lk.unlock();
+
+        send(batch);
+        batch.clear();
+
+        lk.lock();
+    }
+}
+
+void MotionEventBus::send(std::vector<MotionEvent>& batch)
+{
+    //the publishers might be faster than us: send in chunks of (max_batch)
+    for (size_t offset = 0; offset < batch.size(); offset += bus_params.max_batch)
+    {
+        size_t count = std::min(bus_params.max_batch, batch.size() - offset);
+
+        MotionEventBatchHeader header;
+        header.count = (uint16_t)count;
+        header.sequence = sequence++;
+
+        wire_buffer.resize(sizeof(header) + count * sizeof(MotionEvent));
+        ::memcpy(wire_buffer.data(), &header, sizeof(header));
+        ::memcpy(wire_buffer.data() + sizeof(header), batch.data() + offset, count * sizeof(MotionEvent));
+
+        const std::string& topic(bus_params.topic);
+        if (0 > zmq_send(zsocket, topic.data(), topic.size(), ZMQ_SNDMORE | ZMQ_DONTWAIT)
+            || 0 > zmq_send(zsocket, wire_buffer.data(), wire_buffer.size(), ZMQ_DONTWAIT))
+        {
+            counters.dropped.fetch_add(count);
+            continue;
+        }
+        counters.batches.fetch_add(1);
+    }
+}
+
+}//ZMBEntities
@@ -0,0 +1,139 @@
+#ifndef MOTION_EVENT_BUS_H
+#define MOTION_EVENT_BUS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include "boost/noncopyable.hpp"
+
+namespace ZMBEntities {
+
+#pragma pack(push, 1)
+/** Compact binary motion event, as it goes to the wire.
+ * Fields are in host byte order (little-endian on all our targets).*/
+struct MotionEvent
+{
+    /** Same values as CVBGS::MotionDescription::Type,
+     * the tamper types are (TAMPER_BASE + TamperDetector::Kind) in TAMPER_ZONE.*/
+    enum Type : uint8_t { Uncertain = 0, Blick = 1, Motion = 2,
+                          TAMPER_BASE = 16,
+                          TamperCovered = 16, TamperDefocused = 17, TamperMoved = 18 };
+
+    /** Same values as CVBGS::MotionDescription::State */
+    enum State : uint8_t { Null = 0, Invoked = 1, Moving = 2, Calmed = 3 };
+
+    /** Zone number of the whole-frame detector.*/
+    static constexpr uint16_t FULL_FRAME_ZONE = 0xFFFF;
+    /** Zone number of the camera tamper events (Invoked: raised, Calmed: cleared).*/
+    static constexpr uint16_t TAMPER_ZONE = 0xFFFE;
+
+    uint32_t camera = 0;
+    uint16_t zone = FULL_FRAME_ZONE;
+    uint8_t  type = Uncertain;
+    uint8_t  state = Null;
+    int64_t  ts_usec = 0;    //< microseconds since the Epoch
+    float    pixel_ratio = 0.0f; //< part of the moving pixels [0.0, 1.0]
+
+    /** Events with equal keys may be coalesced.*/
+    uint64_t key() const { return ((uint64_t)camera << 16) | zone; }
+};
+#pragma pack(pop)
+
+static_assert(sizeof(MotionEvent) == 20, "MotionEvent wire size changed");
+
+#pragma pack(push, 1)
+/** Heading of each published batch, followed by (count) MotionEvent items.*/
+struct MotionEventBatchHeader
+{
+    static constexpr uint16_t VERSION = 1;
+    uint16_t version = VERSION;
+    uint16_t count = 0;
+    uint32_t sequence = 0; //< gaps mean lost batches
+};
+#pragma pack(pop)
+
+/** Parse a batch payload. @return FALSE on malformed data. */
+bool ParseMotionEventBatch(const void* data, size_t len,
+                           MotionEventBatchHeader& header, std::vector<MotionEvent>& events);
+
+//-----------------------------------------------------------------------------
+struct MotionEventBusParams
+{
+    std::string endpoint = "tcp://*:5570";
+    std::string topic = "zmb.motion";
+    int send_hwm = 1000;        //< ZMQ_SNDHWM in batches
+    size_t max_batch = 512;     //< flush as soon as this number of events pending
+    int flush_interval_ms = 20; //< flush at least that often if there is something
+    bool coalesce = true;       //< merge same (camera, zone, type, state) events in a batch
+};
+
+/** Collects motion events from all the detectors and publishes them
+ * in batches through a ZeroMQ PUB socket from it's own thread.
+ *
+ * publish() makes no syscalls: the event is appended (or coalesced)
+ * to the pending batch under a mutex. A batch is one ZMQ message:
+ * [topic][MotionEventBatchHeader + N * MotionEvent].
+ * Coalescing replaces timestamp and pixel ratio of the pending event with the same
+ * camera/zone/type/state, so state transitions are never lost.
+ */
+class MotionEventBus : public boost::noncopyable
+{
+public:
+    struct Stats
+    {
+        Stats() { published = 0; coalesced = 0; batches = 0; dropped = 0; refused = 0; }
+        std::atomic<uint64_t> published; //< accepted by publish()
+        std::atomic<uint64_t> coalesced; //< merged into pending events
+        std::atomic<uint64_t> batches;   //< messages sent
+        std::atomic<uint64_t> dropped;   //< events of batches that zmq refused
+        std::atomic<uint64_t> refused;   //< by publish(): the bus isn't open, or too many pending
+    };
+
+    MotionEventBus();
+    virtual ~MotionEventBus();
+
+    /** Bind the socket and start the flushing thread.*/
+    bool open(const MotionEventBusParams& params = MotionEventBusParams());
+
+    /** Flush pending events, stop the thread and close the socket.*/
+    void close();
+
+    bool is_open() const {return nullptr != zsocket;}
+
+    /** Thread-safe, never blocks on I/O.
+     * The event is dropped (and counted as refused) when the bus isn't open,
+     * or when (send_hwm) batches are pending already: the socket would refuse them anyway.*/
+    void publish(const MotionEvent& event);
+
+    const Stats& stats() const {return counters;}
+    const MotionEventBusParams& params() const {return bus_params;}
+
+private:
+    void run();
+    void send(std::vector<MotionEvent>& batch);
+
+    MotionEventBusParams bus_params;
+    void* zcontext;
+    void* zsocket;
+
+    std::mutex pending_mutex;
+    std::condition_variable pending_cond;
+    std::vector<MotionEvent> pending;
+    std::unordered_map<uint64_t, size_t> pending_index;//< key() -> last position in (pending)
+    size_t pending_limit;//< (send_hwm) batches of (max_batch) events
+    bool should_run;
+    std::thread flusher;
+
+    uint32_t sequence;
+    std::vector<char> wire_buffer;
+    Stats counters;
+};
+
+}//ZMBEntities
+
+#endif // MOTION_EVENT_BUS_H
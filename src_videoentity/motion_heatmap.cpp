@@ -0,0 +1,210 @@
+#include "motion_heatmap.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cinttypes>
+#include <boost/filesystem.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "../src/minor/cpu_dispatch.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if ZMB_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace ZMBEntities {
+
+MotionHeatmap::MotionHeatmap(uint32_t camera, const ZMFS::FSLocation& location, int64_t flush_period_usec)
+    : camera(camera), flush_period_usec(flush_period_usec), location(location),
+      width(0), height(0), from_usec(-1), last_usec(0), frames(0)
+{
+    try
+    {
+        boost::filesystem::create_directories(boost::filesystem::path(location.location));
+    }
+    catch(boost::filesystem::filesystem_error& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+    }
+}
+
+MotionHeatmap::~MotionHeatmap()
+{
+    if (frames > 0)
+        flush(last_usec);
+}
+
+typedef void (*AccumulateFn)(uint16_t* acc, const uint8_t* mask, size_t len);
+
+static void AccumulateScalar(uint16_t* acc, const uint8_t* mask, size_t len)
+{
+    for (size_t c = 0; c < len; ++c)
+    {
+        uint32_t v = (uint32_t)acc[c] + mask[c];
+        acc[c] = (uint16_t)(v > 0xFFFF ? 0xFFFF : v);
+    }
+}
+
+#ifdef __SSE2__
+static void AccumulateSSE2(uint16_t* acc, const uint8_t* mask, size_t len)
+{
+    size_t c = 0;
+    const __m128i zero = _mm_setzero_si128();
+    for (; c + 16 <= len; c += 16)
+    {
+        __m128i m = _mm_loadu_si128((const __m128i*)(mask + c));
+        __m128i lo = _mm_unpacklo_epi8(m, zero);
+        __m128i hi = _mm_unpackhi_epi8(m, zero);
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(acc + c));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(acc + c + 8));
+        _mm_storeu_si128((__m128i*)(acc + c), _mm_adds_epu16(a0, lo));
+        _mm_storeu_si128((__m128i*)(acc + c + 8), _mm_adds_epu16(a1, hi));
+    }
+    AccumulateScalar(acc + c, mask + c, len - c);
+}
+#else
+static const AccumulateFn AccumulateSSE2 = nullptr;
+#endif
+
+#if ZMB_SIMD_X86
+ZMB_TARGET_AVX2 static void AccumulateAVX2(uint16_t* acc, const uint8_t* mask, size_t len)
+{
+    size_t c = 0;
+    for (; c + 16 <= len; c += 16)
+    {
+        __m256i m = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(mask + c)));
+        __m256i a = _mm256_loadu_si256((const __m256i*)(acc + c));
+        _mm256_storeu_si256((__m256i*)(acc + c), _mm256_adds_epu16(a, m));
+    }
+    AccumulateScalar(acc + c, mask + c, len - c);
+}
+
+ZMB_TARGET_AVX512 static void AccumulateAVX512(uint16_t* acc, const uint8_t* mask, size_t len)
+{
+    size_t c = 0;
+    for (; c + 32 <= len; c += 32)
+    {
+        __m512i m = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(mask + c)));
+        __m512i a = _mm512_loadu_si512((const void*)(acc + c));
+        _mm512_storeu_si512((void*)(acc + c), _mm512_adds_epu16(a, m));
+    }
+    AccumulateScalar(acc + c, mask + c, len - c);
+}
+#else
+static const AccumulateFn AccumulateAVX2 = nullptr;
+static const AccumulateFn AccumulateAVX512 = nullptr;
+#endif
+
+void MotionHeatmap::Accumulate(uint16_t* acc, const uint8_t* mask, size_t len)
+{
+    static const AccumulateFn fn = ZMB::SelectKernel<AccumulateFn>(AccumulateScalar, AccumulateSSE2,
+                                                                   AccumulateAVX2, AccumulateAVX512);
+    fn(acc, mask, len);
+}
+
+void MotionHeatmap::add(const cv::Mat* mask, int64_t ts_usec)
+{
+    if (from_usec < 0)
+        from_usec = ts_usec;
+    if (ts_usec - from_usec >= flush_period_usec)
+        flush(ts_usec);
+    last_usec = ts_usec;
+    ++frames;
+
+    if (nullptr == mask || mask->empty() || CV_8UC1 != mask->type())
+        return;
+    if (mask->cols != width || mask->rows != height)
+    {//the detection resolution has changed
+        if (!acc.empty())
+            flush(ts_usec);
+        width = mask->cols;
+        height = mask->rows;
+        acc.assign((size_t)width * height, 0);
+    }
+    for (int y = 0; y < height; ++y)
+    {
+        Accumulate(&acc[(size_t)y * width], mask->ptr<uint8_t>(y), (size_t)width);
+    }
+}
+
+bool MotionHeatmap::flush(int64_t ts_usec)
+{
+    bool ok = true;
+    if (!acc.empty() && frames > 0)
+    {
+        char fname[96];
+        snprintf(fname, sizeof(fname), "heat_%u_%" PRId64 "_%" PRId64 ".png",
+                 camera, from_usec, ts_usec);
+        std::string path;
+        location.absolute_path(path, fname);
+
+        cv::Mat heat(height, width, CV_16UC1, acc.data());
+        ok = cv::imwrite(path, heat, {cv::IMWRITE_PNG_COMPRESSION, 6});
+        if (!ok)
+            std::cerr << "Can't write the heatmap " << path << "\n";
+    }
+    std::fill(acc.begin(), acc.end(), 0);
+    from_usec = ts_usec;
+    frames = 0;
+    return ok;
+}
+
+void MotionHeatmap::AddHeatmap(cv::Mat& out, const cv::Mat& heat16)
+{
+    if (out.empty())
+        out = cv::Mat::zeros(heat16.size(), CV_32SC1);
+    if (out.size() != heat16.size())
+    {
+        std::cerr << "Heatmap of other resolution skipped\n";
+        return;
+    }
+    cv::Mat heat32;
+    heat16.convertTo(heat32, CV_32S);
+    out += heat32;
+}
+
+bool MotionHeatmap::QueryStored(const ZMFS::FSLocation& location, uint32_t camera,
+                                int64_t from_usec, int64_t to_usec, cv::Mat& out)
+{
+    using namespace boost::filesystem;
+    bool found = false;
+    try
+    {
+        for (directory_iterator iter(path(location.location)), end; iter != end; ++iter)
+        {
+            std::string name = iter->path().filename().string();
+            unsigned cam = 0;
+            int64_t f = 0, t = 0;
+            if (3 != sscanf(name.c_str(), "heat_%u_%" SCNd64 "_%" SCNd64 ".png", &cam, &f, &t)
+                    || cam != camera || t <= from_usec || f >= to_usec)
+                continue;
+            cv::Mat heat = cv::imread(iter->path().string(), cv::IMREAD_UNCHANGED);
+            if (heat.empty() || CV_16UC1 != heat.type())
+                continue;
+            AddHeatmap(out, heat);
+            found = true;
+        }
+    }
+    catch(filesystem_error& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+    }
+    return found;
+}
+
+bool MotionHeatmap::query(int64_t from, int64_t to, cv::Mat& out) const
+{
+    bool found = QueryStored(location, camera, from, to, out);
+    if (!acc.empty() && frames > 0 && last_usec > from && from_usec < to)
+    {
+        cv::Mat heat(height, width, CV_16UC1, (void*)acc.data());
+        AddHeatmap(out, heat);
+        found = true;
+    }
+    return found;
+}
+
+}//ZMBEntities
@@ -0,0 +1,67 @@
+#ifndef MOTION_HEATMAP_H
+#define MOTION_HEATMAP_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+#include "../src/fshelper.h"
+
+namespace ZMBEntities {
+
+/** Per-camera activity heatmap: counts the frames each pixel of the detection
+ * resolution was in motion.
+ *
+ * The foreground mask (0/1 bytes) is added to a 16-bit accumulator with saturating
+ * SIMD adds (16 pixels per step), a few microseconds per thumbnail.
+ * Every (flush_period_usec) of the stream's time the accumulator is written as a
+ * 16-bit PNG "heat_<camera>_<from usec>_<to usec>.png" into the location and restarted.
+ * The times are microseconds since the Epoch, see ZMB::MediaClock::wall_usec().
+ * At 25 fps a pixel saturates after 43 minutes of continuous motion,
+ * keep the period below that.
+ * Not thread-safe: one per detector.*/
+class MotionHeatmap
+{
+public:
+    MotionHeatmap(uint32_t camera, const ZMFS::FSLocation& location,
+                  int64_t flush_period_usec = 10LL * 60 * 1000 * 1000);
+    ~MotionHeatmap();
+
+    /** Account a frame.
+     * @param mask -- CV_8UC1 foreground of 0/1 values, NULL: no motion on this frame.*/
+    void add(const cv::Mat* mask, int64_t ts_usec);
+
+    /** Write the current accumulator now and restart it.
+     * @return FALSE on IO errors.*/
+    bool flush(int64_t ts_usec);
+
+    /** Sum of the stored heatmaps overlapping [from_usec, to_usec) and the current one,
+     * into (out) CV_32SC1. A heatmap is taken whole if it overlaps the range.
+     * @return FALSE if nothing was found.*/
+    bool query(int64_t from_usec, int64_t to_usec, cv::Mat& out) const;
+
+    /** Same for the files only, e.g. from another process.*/
+    static bool QueryStored(const ZMFS::FSLocation& location, uint32_t camera,
+                            int64_t from_usec, int64_t to_usec, cv::Mat& out);
+
+    /** Saturating add of (len) 0/1 bytes to the 16-bit counters, SSE2, AVX2 or AVX-512 (ZMB::ActiveSimd()).*/
+    static void Accumulate(uint16_t* acc, const uint8_t* mask, size_t len);
+
+    const uint32_t camera;
+    const int64_t flush_period_usec;
+
+private:
+    static void AddHeatmap(cv::Mat& out, const cv::Mat& heat16);
+
+    ZMFS::FSLocation location;
+    int width;
+    int height;
+    std::vector<uint16_t> acc;
+    int64_t from_usec;
+    int64_t last_usec;
+    uint64_t frames;
+};
+
+}//ZMBEntities
+
+#endif // MOTION_HEATMAP_H
@@ -0,0 +1,206 @@
+#ifndef MOTION_RECORDER_H
+#define MOTION_RECORDER_H
+
+#include <memory>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include "movement_detector.h"
+
+struct AVFormatContext;
+namespace av { class Packet; }
+
+namespace ZMBEntities {
+
+/** Detection-to-disk latency of the started clips, milliseconds.*/
+struct RecordingLatencyStats
+{
+    uint64_t clips = 0;
+    double last_ms = 0.0;
+    double max_ms = 0.0;
+    double sum_ms = 0.0;
+
+    double mean_ms() const {return clips > 0 ? sum_ms / clips : 0.0;}
+
+    void add(double ms)
+    {
+        ++clips;
+        last_ms = ms;
+        max_ms = std::max(max_ms, ms);
+        sum_ms += ms;
+    }
+};
+
+struct MotionRecorderParams
+{
+    double preroll_seconds = 2.0;  //< minimum of the buffered video before the event
+    double postroll_seconds = 5.0; //< keep writing after the motion has calmed
+};
+
+/** Writes video clips on motion events: links MotionDelayedTrigger states,
+ * PacketsPocket's pre-roll and FFileWriter without decoding or re-encoding.
+ *
+ * TPocket: has push(std::shared_ptr<av::Packet>) and visit_preroll(seconds, seq_key_t&, acceptor)
+ *   (ZMB::PacketsPocket)
+ * TWriter: has open(const AVFormatContext*, path), accept(std::shared_ptr<av::Packet>), close()
+ *   (ZMB::FFileWriter<>)
+ *
+ * The clip starts on Invoked/Moving with the packets from the keyframe that is
+ * (preroll_seconds) old, then the live packets are written while the motion persists
+ * and (postroll_seconds) after it has Calmed(or went Null).
+ * onPacket() is called from the reading thread, onMotion() from the detection thread.
+ */
+template<class TPocket, class TWriter>
+class MotionRecorder
+{
+public:
+    typedef std::shared_ptr<av::Packet> AvPacketPtr;
+    typedef typename TPocket::MarkedPacket::first_type SeqKey;//< ZMB::seq_key_t
+    typedef std::chrono::steady_clock Clock;
+
+    /** Must return the destination of the next clip, see ZMFS::FSHelper::spawn_temp().*/
+    typedef std::function<std::string()> MakeClipPathFunc;
+
+    /** Called after the clip was closed.*/
+    typedef std::function<void(const std::string& path)> OnClipClosedFunc;
+
+    enum State { Idle, Starting, Recording, PostRoll };
+
+    MotionRecorder(TPocket& pocket, TWriter& writer, const AVFormatContext* input_ctx)
+        : pocket(pocket), writer(writer), input_ctx(input_ctx), state(Idle)
+    {  }
+
+    ~MotionRecorder()
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        close_clip();
+    }
+
+    /** Buffer the packet and write it if a clip is open.*/
+    void onPacket(AvPacketPtr pkt)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        pocket.push(pkt);
+
+        switch (state)
+        {
+        case Starting:
+            start_clip();
+            break;
+        case PostRoll:
+            if (Clock::now() >= postroll_deadline)
+            {
+                close_clip();
+                break;
+            }
+            //fall through: keep writing
+        case Recording:
+            writer.accept(pkt);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /** Feed the detector's state.*/
+    void onMotion(const CVBGS::MotionDescription& desc)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        switch (desc.state)
+        {
+        case CVBGS::MotionDescription::Invoked:
+        case CVBGS::MotionDescription::Moving:
+            if (Idle == state)
+            {//the next packet will open the clip
+                detected_at = Clock::now();
+                state = Starting;
+            }
+            else if (PostRoll == state)
+            {
+                state = Recording;
+            }
+            break;
+
+        case CVBGS::MotionDescription::Calmed:
+        case CVBGS::MotionDescription::Null:
+            if (Recording == state)
+            {
+                postroll_deadline = Clock::now()
+                        + std::chrono::microseconds((int64_t)(params.postroll_seconds * 1e6));
+                state = PostRoll;
+            }
+            else if (Starting == state && CVBGS::MotionDescription::Null == desc.state)
+            {//it was a blick, nothing was written yet
+                state = Idle;
+            }
+            break;
+        }
+    }
+
+    State current_state() const {return state;}
+
+    RecordingLatencyStats latency() const
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        return latency_stats;
+    }
+
+    MotionRecorderParams params;
+    MakeClipPathFunc makeClipPath;
+    OnClipClosedFunc onClipClosed;
+
+private:
+    /** Adapts the writer to the pocket's visitor.*/
+    struct WriterAcceptor
+    {
+        TWriter* pwriter;
+        void operator()(AvPacketPtr pkt) { pwriter->accept(pkt); }
+    };
+
+    void start_clip()
+    {
+        clip_path = makeClipPath ? makeClipPath() : std::string();
+        if (clip_path.empty() || !writer.open(input_ctx, clip_path))
+        {
+            state = Idle;
+            return;
+        }
+        WriterAcceptor acceptor = {&writer};
+        SeqKey last_written;
+        pocket.visit_preroll(params.preroll_seconds, last_written, acceptor);
+
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - detected_at).count();
+        latency_stats.add(ms);
+        state = Recording;
+    }
+
+    void close_clip()
+    {
+        if (Idle == state || Starting == state)
+        {
+            state = Idle;
+            return;
+        }
+        writer.close();
+        state = Idle;
+        if (onClipClosed)
+            onClipClosed(clip_path);
+    }
+
+    TPocket& pocket;
+    TWriter& writer;
+    const AVFormatContext* input_ctx;
+
+    mutable std::mutex mutex;
+    State state;
+    Clock::time_point detected_at;
+    Clock::time_point postroll_deadline;
+    std::string clip_path;
+    RecordingLatencyStats latency_stats;
+};
+
+}//ZMBEntities
+
+#endif // MOTION_RECORDER_H
@@ -3,17 +3,82 @@
 
 #include <functional>
 #include <memory>
+#include <atomic>
 #include <Poco/Task.h>
+#include <Poco/AutoPtr.h>
 #include "../src/mimage.h"
+#include "../src/picture_pyramid.h"
+#include "../src/minor/latest_slot.hpp"
+#include "../src/minor/cancellable_queue.hpp"
+#include "movement_detector.h"
+#include "roi_inference_stage.h"
 
 namespace ZMBEntities {
 
+/** Detection stage of the pipeline: the decoding thread pushes frames,
+ * the task runs MovementDetector::detect() on them in it's own thread.
+ *
+ * The input queue is bounded: when the detector falls behind,
+ * the oldest pending frame is dropped (and counted) instead of blocking the producer.
+ * Task's progress reported to the TaskManager is the queue fill level [0.0, 1.0].
+ *
+ * Each frame gets a ZMB::PicturePyramid: the detector takes it's scaled picture from there
+ * and onDetected receives it, so the other consumers reuse the levels made already.
+ */
 class MovementDetectionTask : public Poco::Task
 {
 public:
-    MovementDetectionTask(const std::string& name);
-    
-    
+    typedef std::function<void(const CVBGS::MotionDescription&, const ZMB::PyramidSharedPtr&)> OnDetectedAction;
+
+    /** Frame counters, may be read from any thread.*/
+    struct Stats
+    {
+        Stats() { received = 0; processed = 0; dropped = 0; }
+        std::atomic<uint64_t> received;
+        std::atomic<uint64_t> processed;
+        std::atomic<uint64_t> dropped;//< frames pushed out of the full queue
+    };
+
+    MovementDetectionTask(const std::string& name, size_t queueCapacity = 8);
+    virtual ~MovementDetectionTask();
+
+    /** Enqueue a frame, never blocks. The frame is published to (latest_frame) too,
+     * so push() must be called from one (the decoding) thread.
+     * @return FALSE if the queue was full and the oldest frame was dropped.*/
+    bool push(ZMB::PictureSharedPtr frame);
+
+    /** Processing loop, exits on cancel().*/
+    void runTask() override;
+
+    /** Cancels the task and wakes up the processing loop.*/
+    void cancel() override;
+
+    size_t capacity() const {return frames_queue.capacity();}
+    const Stats& stats() const {return counters;}
+
+    /** Must be configured before the task is started.*/
+    MovementDetector detector;
+
+    //should be set before the task is started, called from the task's thread
+    OnDetectedAction onDetected;
+
+    /** The camera's newest frame for the GUI, the snapshots etc.: read it from any thread,
+     * the readers never block the decoding.*/
+    ZMB::LatestSlot<ZMB::PictureHolder> latest_frame;
+
+    /** Counters of the frames' pyramids, may be shared by all the cameras' tasks.*/
+    std::shared_ptr<ZMB::PyramidStats> pyramid_stats = std::make_shared<ZMB::PyramidStats>();
+
+    /** If set, the moving blobs' crops are sent there while the motion is active.
+     * May be shared by all the cameras' tasks. The stage is a Poco::Task, reference counted:
+     * the TaskManager takes one reference, start it with start(inference.duplicate()).*/
+    Poco::AutoPtr<RoiInferenceStage> inference;
+    size_t inference_blobs = 3;//< largest blobs of a frame to classify
+
+private:
+    ZMB::CancellableQueue<ZMB::PictureSharedPtr> frames_queue;
+
+    Stats counters;
 };
 
 }//ZMBEntities
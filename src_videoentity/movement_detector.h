@@ -0,0 +1,1090 @@
+#ifndef MOVEMENT_DETECTOR_H
+#define MOVEMENT_DETECTOR_H
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+}
+
+#include <map>
+#include <memory>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include "Poco/Timespan.h"
+#include "Poco/Timestamp.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/background_segm.hpp>
+#include <json/json.h>
+
+#ifndef __LOCAL_JSON_EXT__
+#define __LOCAL_JSON_EXT__ 1
+#define JSON_EXTR_INT(JOBJECT, KEY, DEFAULT_VAL) \
+    (JOBJECT).get((KEY), Json::Value((DEFAULT_VAL))).asInt()
+
+#define JSON_EXTR_DBL(JOBJECT, KEY, DEFAULT_VAL) \
+    (JOBJECT).get((KEY), Json::Value((DEFAULT_VAL))).asDouble()
+
+#endif
+
+#include "../src/mimage.h"
+#include "../src/picture.h"
+#include "../src/picture_pyramid.h"
+#include "../src/minor/media_clock.h"
+#include "../src/minor/cpu_dispatch.h"
+#include "delaunay/Triangulation.h"
+#include "motion_event_bus.h"
+#include "mv_grid.h"
+#include "bgs_snapshot.h"
+#include "blob_extractor.h"
+#include "blob_tracker.h"
+#include "tamper_detector.h"
+#include "motion_heatmap.h"
+#include "zone_rasterizer.h"
+#include "zone_index.h"
+
+namespace CVBGS {
+
+/** A motion detector's point of view on events.
+ * That could be either nothing, a light blick, an object motion.
+ * Current event state has an uncertain state(null), active states(Invoked, Moving),
+ * calm state.
+*/
+struct MotionDescription
+{
+    enum Type   { Uncertain, Blick, Motion };
+    enum State { Null, Invoked, Moving, Calmed };
+
+    MotionDescription() : type(Uncertain), state(Null), pixel_ratio(0.0f) {}
+    MotionDescription(const Type &type, const State &state) : type(type), state(state), pixel_ratio(0.0f) {}
+
+    Type type;
+    State state;
+    float pixel_ratio;//< part of the frame's pixels that are moving
+    std::vector<ZMBEntities::MotionBlob> blobs;//< moving areas in the frame's coordinates, largest first
+};
+
+/** A pair of a time segment and it's start time, microseconds.
+ * The start time is "not timed" after construction or clear(), the segment is 0 by default.
+ * With a bound ZMB::MediaClock (see set_clock()), advanced once per frame by the detector,
+ * time() schedules the segment's end on the clock's timer wheel: is_elapsed() reads the flag
+ * the timer sets, the delay ends within the wheel's resolution. After the clock's reset(),
+ * or without a clock (the coarse monotonic clock then), the time is compared instead.
+*/
+struct TimeSegment : public std::pair<Poco::Timespan/*segment legth*/,
+                                    Poco::Timestamp::TimeVal /*start time or TIMEVAL_MIN*/>
+{
+    TimeSegment() : clock(nullptr), timer(ZMB::TimerWheel::INVALID_TIMER), clock_resets(0)
+    {
+        set_time_segment(0);
+        clear();
+    }
+
+    TimeSegment(Poco::Timespan duration) : TimeSegment()
+        { set_time_segment(duration); }
+
+    void set_time_segment(Poco::Timespan duration)
+        { first = duration; }
+
+    void set_clock(ZMB::MediaClock* media_clock)
+    {
+        clear();
+        clock = media_clock;
+    }
+
+    inline Poco::Timestamp::TimeVal ts() const {return second;}
+    inline const Poco::Timespan& duration() const {return first;}
+
+    inline Poco::Timestamp::TimeVal now() const
+    {
+        return nullptr != clock ? clock->now() : ZMB::MediaClock::CoarseMonotonicUsec();
+    }
+
+    /*Set to current time.*/
+    void time()
+    {
+        cancel_timer();
+        second = now();
+        if (nullptr == clock || first.totalMicroseconds() <= 0)
+            return;
+        //the flag outlives this segment if the timer does: no dangling callbacks
+        std::shared_ptr<bool> flag = std::make_shared<bool>(false);
+        timer = clock->schedule_in(first.totalMicroseconds(), [flag]() { *flag = true; });
+        elapsed = flag;
+        clock_resets = clock->resets();
+    }
+
+    /** @return TRUE if is not in 0-state*/
+    bool is_timed() const
+    {
+        return second > Poco::Timestamp::TIMEVAL_MIN;
+    }
+    bool is_elapsed() const
+    {
+        if (nullptr != elapsed && clock_resets == clock->resets())
+            return *elapsed;
+        return now() - second >= first.totalMicroseconds();
+    }
+
+    /** reset the start time to 0-state, the segment length is kept */
+    void clear()
+    {
+        cancel_timer();
+        second = Poco::Timestamp::TIMEVAL_MIN;
+    }
+
+    ZMB::MediaClock* clock;//< not owned, NULL by default
+
+private:
+    void cancel_timer()
+    {
+        if (nullptr == elapsed)
+            return;
+        if (clock_resets == clock->resets())
+            clock->timers().cancel(timer);
+        elapsed.reset();
+        timer = ZMB::TimerWheel::INVALID_TIMER;
+    }
+
+    ZMB::TimerWheel::TimerId timer;
+    std::shared_ptr<bool> elapsed;//< set by the timer, NULL when not scheduled
+    uint64_t clock_resets;
+};
+
+
+//==============================
+/** Sets low/high level with a time delay,
+ * depending on current value.
+ * (input tri-state){-1,0,1} --> (trigger)[state: {off,on}]
+ * First input tristate does not modify the triggers state,
+ * but it'll ignite the timer (presented as integer value).
+ * On next input tristate, the trigger will change it's state or reset the delay timer.
+ *
+ * 1. If the current state of the trigger is "off"(0) and tri-state valus is 1:
+ *
+ * (a) if the delay is timed out then we set trigger's state to On(1)
+ *  and reset the delay timer to 0-state.
+ *
+ * (b) if the delay is NOT timed out : nothing happens, wait for next input value.
+ *
+ * 2. Case the current state is "on"(1) and tri-state is 1 or 0:
+ *    Clear the delay timer to 0-state, unused until changed value comes on input.
+ *
+ * 3. Case state == "on"(1) and input value == -1:
+ * (a)if the delay is timed out then we set trigger's state to Off(0)
+ *  and reset the delay timer.
+ *
+ * (b) if the delay is NOT timed out : nothing happens, wait for next input value.
+ *
+ * 4. Case state == "off"(0) and input value == -1:
+ *  and reset the delay timer to 0-state.
+ *
+ *
+ * @verbatim
+ Suppose trigger's delay equals 2 time units presented as "-",
+ an example of input and output levels is shown below.
+
+Input tristate {-1,0,1}:
+1       ___________
+       /           \                     /\
+0-----+------------+---------+----------+-+----
+                   \________/
+-1
+Trigger's state:
+On       ___________
+        /           \
+of-----t-+-----------t-------t----------t-t----
+
+"t" stands for trigger's delay timer reset, as we can see only 1 of the input
+tristate pulses changed the trigger's state and made it to keep level On
+during some time segment.
+
+ * @endverbatim
+*/
+struct TresholdDelayedTrigger
+{
+    enum State { Off = 0, On = 1 };
+
+    TresholdDelayedTrigger(): state(Off) {  }
+
+    TresholdDelayedTrigger(TimeSegment time_delay)
+        : state(Off), delay(time_delay) {  }
+
+    inline void invert()
+        { state = (Off == state) ? On : Off; }
+
+    /** First call does not change the trigger's state,
+     *  but will time the delay, next call can return modified state of the trigger.*/
+    State input(int tristate/*{-1, 0, 1}*/)
+    {
+        if ((state == Off && tristate > 0) ||
+            (state == On  && tristate < 0))
+        {   //case we have level change
+
+            if (!delay.is_timed())
+            { //set up the time segment if it was not and return(making a delay)
+                delay.time();
+                return state;
+            }
+
+            //we have a time out, let's invert the state
+            if (delay.is_elapsed())
+            {//change to low level after a timeout, okay, seem not to be a light blick
+                invert();
+                delay.clear();
+            }
+            //else do nothing, wait for next value on input
+
+        }
+        else /*if (0 == tristate
+                 || 1 == tristate && this->state == 1
+                 || 0 == tristate && this->state == 0)*/
+            if(delay.is_timed())
+            {//no level change, reset the delay timer to 0-state
+                delay.clear();
+            }
+
+        return state;
+    }
+
+    void set_delay(const Poco::Timespan& delay_usec)
+        { delay.set_time_segment(delay_usec);}
+
+    void set_clock(ZMB::MediaClock* media_clock)
+        { delay.set_clock(media_clock); }
+
+
+    TimeSegment delay;
+    State     state;
+};
+
+//==============================
+/** A structure that is able to track tristate{-1. 0, 1} changes that
+ * describe frame's motion alert state.
+ * "-1" stands for negative difference in motion sensor's value(a decrease of motion).
+ * "0" value stands for no changes,
+ * "1" stands for increase of moving objects.
+*/
+struct MotionDelayedTrigger
+{
+    MotionDelayedTrigger()
+    {
+        blick_trigger.set_delay(Poco::Timespan(100 * 1000/*usec*/));
+        object_motion_trigger.set_delay(Poco::Timespan(500 * 1000/*usec*/));
+    }
+
+    /** @return a description of the event, it can be described as moving or as idle object*/
+    MotionDescription track(int tristate)
+    {
+        auto st_blick = blick_trigger.input(tristate);
+        auto st_object = object_motion_trigger.input(TresholdDelayedTrigger::On == st_blick? 1 : -1);
+        MotionDescription::Type mo_type = MotionDescription::Type::Uncertain;
+        MotionDescription::State mo_state = MotionDescription::State::Null;
+
+        if (TresholdDelayedTrigger::On == st_blick)
+            mo_type = MotionDescription::Type::Blick;
+
+        if (TresholdDelayedTrigger::On == st_object)
+            mo_type = MotionDescription::Type::Motion;
+
+        if (TresholdDelayedTrigger::Off == st_object)
+        {
+            mo_state = (TresholdDelayedTrigger::On == st_blick?
+                        MotionDescription::State::Invoked : MotionDescription::State::Null);
+        }
+        else
+        {//On == st_object
+            mo_state = (TresholdDelayedTrigger::On == st_blick?
+                            MotionDescription::State::Moving : MotionDescription::State::Calmed);
+        }
+        return {mo_type, mo_state};
+    }
+
+    void set_blick_treshold_delay(const Poco::Int64& msec) {
+        blick_trigger.set_delay(Poco::Timespan(msec * 1000));
+    }
+
+    void set_object_motion_time(const Poco::Int64& msec) {
+        object_motion_trigger.set_delay(Poco::Timespan(msec * 1000));;
+    }
+
+    void set_clock(ZMB::MediaClock* media_clock) {
+        blick_trigger.set_clock(media_clock);
+        object_motion_trigger.set_clock(media_clock);
+    }
+
+
+    TresholdDelayedTrigger blick_trigger;
+    TresholdDelayedTrigger object_motion_trigger;
+};
+
+//==============================
+
+struct BGSParams
+{
+    BGSParams()
+    {
+        Json::Value empty;
+        set_params(empty);
+        frame_cnt = 0;
+    }
+
+    void set_params(const Json::Value& params)
+    {
+        with_downscale = 0 < JSON_EXTR_INT(params, "downscale", 1)? true : false;
+        with_blobs = 0 < JSON_EXTR_INT(params, "blobs", 1);
+        blob_min_area = JSON_EXTR_INT(params, "blob_min_area", 4);
+        with_tracker = 0 < JSON_EXTR_INT(params, "tracker", 0);
+        skip = JSON_EXTR_INT(params, "skip", 40);
+        threshold = JSON_EXTR_DBL(params, "threshold", 0.15);
+        deviation_ratio = JSON_EXTR_DBL(params, "deviation_ratio", 0.005);
+        blur_sigma = JSON_EXTR_DBL(params, "blur_sigma", 2.0);
+    }
+
+    bool with_downscale;
+    bool with_blobs;  //< extract the moving areas, see MotionDescription::blobs
+    int blob_min_area;//< pixels of the detection resolution
+    bool with_tracker;//< blobs' tracks define the state instead of the MotionDelayedTrigger (needs with_blobs)
+    int skip;
+    int frame_cnt;
+
+    double threshold;
+    double blur_sigma;
+    double deviation_ratio;
+
+};
+
+/** Makes video frame motion detection based on MOG2 subtraction algo.*/
+class MOG2Algo
+{
+public:
+    MOG2Algo()
+    {
+        max_frame_size = ZMB::MSize(1920, 1080);
+        mog2 = cv::createBackgroundSubtractorMOG2(500, 16, false);
+        mog2->setVarMin(100);
+        learning_rate = -1.0;
+
+        Element = cv::getStructuringElement( 0, cv::Size( 2, 2 ), cv::Point( -1, -1 ) );
+    }
+
+    // returns 'true' if there's movement.
+    MotionDescription proc(const ZMB::PictureHolder& frame)
+    {
+        return proc(frame, nullptr);
+    }
+
+    /** Same, the detection resolution picture is the (pyramid)'s level,
+     * shared with the frame's other consumers.*/
+    MotionDescription proc(ZMB::PicturePyramid& pyramid)
+    {
+        return proc(*pyramid.base(), &pyramid);
+    }
+
+private:
+    MotionDescription proc(const ZMB::PictureHolder& frame, ZMB::PicturePyramid* pyramid)
+    {
+        //Determine the scaling factor for the downscale
+        //Approximate number of pixels after rescale: full HD downscaled by 8X
+
+        ZMB::MSize inp_sz = frame.dimension;
+        ZMB::MSize dst_sz = inp_sz;
+        if (params.with_downscale)
+        {
+            int width   = inp_sz.width();
+            int height  = inp_sz.height();
+
+            //downscaling:
+            float refNumPixels = max_frame_size.square() / 64.0f;
+            float scale         = std::sqrt((float)(width * height)/refNumPixels);
+            int down_w = std::round((float)width / scale);
+            int down_h = std::round((float)height / scale);
+            dst_sz = ZMB::MSize(down_w, down_h);
+        }
+        //the BGS works on BGR24 pictures of the detection resolution
+        typedef ZMB::Picture<ZMB::PixFmt::BGR24> BGRPicture;
+        MotionDescription res;
+        fg_valid = false;
+        if (nullptr != pyramid)
+        {
+            level_pic = pyramid->get(dst_sz, BGRPicture::Format::AV_FORMAT);
+            if (nullptr == level_pic)
+                return res;
+        }
+        else
+        {
+            if (nullptr == img || img->dimension != dst_sz)
+            {
+                img.reset(new ZMB::PictureHolder(BGRPicture::Allocate(dst_sz)));
+            }
+            if (!ZMB::ScalePicture(*img, frame, swsContextPtr))
+                return res;
+            level_pic.reset();
+        }
+
+        BGRPicture bgr(nullptr != level_pic ? *level_pic : *img);
+        auto sz = bgr.dimension;
+        resized = cv::Mat(sz.height(), sz.width(), CV_8UC3, (void*)bgr.data[0], bgr.strides[0]);
+
+        if (!seed.background.empty())
+        {
+            if (seed.background.size() == resized.size() && seed.background.type() == resized.type())
+            {//the model starts from the stored background instead of the empty one,
+             //then learns at the steady-state rate instead of the warm-up's 1/(2 * frames)
+                mog2->apply(seed.background, mask, 1.0);
+                learning_rate = 1.0 / mog2->getHistory();
+                params.frame_cnt = std::max(params.frame_cnt, params.skip);
+            }
+            seed = ZMBEntities::BackgroundSnapshot();
+        }
+        mog2->apply(resized, mask, learning_rate);
+
+        //BGS needs a warm-up
+        if (++params.frame_cnt < params.skip)
+            return res;
+
+        mask /= 255;
+
+        cv::erode(mask, mask, Element, cv::Point(-1, -1), 1);
+
+        converted = cv::Mat(sz.height(), sz.width(),CV_32FC1);
+        mask.convertTo(converted,CV_32FC1);
+
+        blurred = cv::Mat(sz.height(), sz.width(),CV_32FC1);
+        cv::GaussianBlur(converted,blurred,cv::Size(0,0), params.blur_sigma);
+
+        thresholded = cv::Mat(sz.height(), sz.width(), CV_32FC1);
+        cv::threshold(blurred, thresholded, params.threshold,
+                      1.0, cv::THRESH_BINARY);
+
+        Poco::Int64 area = sz.square();
+        if (!zone_mask.empty())
+        {//the ratios are relative to the enabled area
+            if (zone_off.size() != thresholded.size())
+            {
+                cv::Mat m;
+                cv::resize(zone_mask, m, thresholded.size(), 0, 0, cv::INTER_NEAREST);
+                zone_off = (m == 0);
+                zone_area = cv::countNonZero(m);
+            }
+            thresholded.setTo(0.0f, zone_off);
+            area = zone_area;
+        }
+
+        Poco::Int64 nonzero = cv::countNonZero(thresholded);
+        Poco::Int64 level = params.deviation_ratio * area;
+
+        res = frame_treshold_track.track(fn_level_tristate(nonzero, level));
+        res.pixel_ratio = (float)nonzero / (float)std::max<Poco::Int64>(1, area);
+        if (nonzero > 0)
+        {
+            thresholded.convertTo(fg_mask, CV_8U);
+            fg_valid = true;
+        }
+        if (params.with_blobs && fg_valid)
+        {
+            blob_extractor.min_area = params.blob_min_area;
+            res.blobs = blob_extractor.extract(fg_mask.data, fg_mask.cols, fg_mask.rows, (int)fg_mask.step[0]);
+            ZMBEntities::ScaleBlobs(res.blobs, (float)inp_sz.width() / sz.width(),
+                                    (float)inp_sz.height() / sz.height());
+        }
+        if (params.with_blobs && params.with_tracker)
+        {//the frames without blobs age the tracks too
+            tracker.update(res.blobs, nullptr != clock ? clock->now() : ZMB::MediaClock::CoarseMonotonicUsec());
+            apply_tracks(res);
+        }
+        return res;
+    }
+
+public:
+    /** Bind the triggers to the stream's clock, their delays are it's timers.*/
+    void set_clock(ZMB::MediaClock* media_clock)
+    {
+        clock = media_clock;
+        frame_treshold_track.set_clock(media_clock);
+    }
+
+    /** The learnt background of the detection resolution, empty during the warm-up.*/
+    ZMBEntities::BackgroundSnapshot snapshot() const
+    {
+        ZMBEntities::BackgroundSnapshot res;
+        if (params.frame_cnt < params.skip)
+            return res;
+        mog2->getBackgroundImage(res.background);
+        res.frame_cnt = (uint32_t)params.frame_cnt;
+        return res;
+    }
+
+    /** Seed the model with a stored background on next proc(),
+     * it's ignored if the detection resolution has changed.
+     * OpenCV does not expose the mixtures (means, variances, weights),
+     * so the model restarts from the background picture with the initial variance.*/
+    void restore(const ZMBEntities::BackgroundSnapshot& snap)
+        { seed = snap; }
+
+    /** Image-resolution CV_8UC1 mask, non-zero: detection enabled. Empty: the whole frame.
+     * It's scaled once to the detection resolution.*/
+    void set_zone_mask(const cv::Mat& mask)
+    {
+        zone_mask = mask;
+        zone_off.release();
+        zone_area = 0;
+    }
+
+    /** Last detection-resolution BGR picture, valid until the next proc().*/
+    const cv::Mat& thumbnail() const {return resized;}
+
+    /** Last foreground mask (0/1 bytes) of the detection resolution,
+     * NULL if nothing moved or during the warm-up.*/
+    const cv::Mat* foreground() const {return fg_valid ? &fg_mask : nullptr;}
+
+    /** Tracks of the moving blobs, updated when params.with_tracker is set.*/
+    const ZMBEntities::BlobTracker& blob_tracker() const {return tracker;}
+
+    inline int fn_level_tristate(const Poco::Int64& value, const Poco::Int64& level)
+    {
+        return (value > level)? 1 : (value < level? -1 : 0);
+    }
+
+    ZMB::MSize max_frame_size;
+    BGSParams params;//< you may modify params before valling proc() method;
+
+private:
+    cv::Mat Element;
+    cv::Mat converted;
+    cv::Mat blurred;
+    cv::Mat thresholded;
+    cv::Mat mask;
+    std::unique_ptr<ZMB::PictureHolder> img;//< downscaled BGR24 picture
+    ZMB::PictureSharedPtr level_pic;//< or the pyramid's one, (resized) points there
+    ZMB::SwsUniquePtr swsContextPtr;
+    cv::Mat resized;
+    ZMBEntities::BackgroundSnapshot seed;
+    cv::Mat fg_mask;//< 8-bit (thresholded)
+    bool fg_valid = false;
+    cv::Mat zone_mask;
+    cv::Mat zone_off;//< detection resolution, non-zero: disabled
+    Poco::Int64 zone_area = 0;
+    ZMBEntities::BlobExtractor blob_extractor;
+    ZMBEntities::BlobTracker tracker;
+    const ZMB::MediaClock* clock = nullptr;
+
+    /** An object is reported once when it's track is confirmed (Invoked),
+     * then it's Moving while any track lives, Calmed when the last one ends.*/
+    void apply_tracks(MotionDescription& res) const
+    {
+        bool started = false, ended = false;
+        for (const ZMBEntities::TrackEvent& ev : tracker.events())
+        {
+            if (ZMBEntities::TrackEvent::Started == ev.kind)
+                started = true;
+            else
+                ended = true;
+        }
+        res.type = MotionDescription::Motion;
+        if (started)
+            res.state = MotionDescription::Invoked;
+        else if (tracker.confirmed() > 0)
+            res.state = MotionDescription::Moving;
+        else if (ended)
+            res.state = MotionDescription::Calmed;
+        else
+        {
+            res.type = MotionDescription::Uncertain;
+            res.state = MotionDescription::Null;
+        }
+    }
+    double learning_rate;//< -1: OpenCV's automatic
+
+    //for tracking of the whole frame:
+    MotionDelayedTrigger frame_treshold_track;
+    cv::Ptr <cv::BackgroundSubtractorMOG2> mog2;
+};
+
+struct MVParams
+{
+    MVParams()
+    {
+        Json::Value empty;
+        set_params(empty);
+    }
+
+    void set_params(const Json::Value& params)
+    {
+        min_magnitude = (float)JSON_EXTR_DBL(params, "mv_min_magnitude", 1.0);
+        min_neighbours = JSON_EXTR_INT(params, "mv_min_neighbours", 1);
+        deviation_ratio = JSON_EXTR_DBL(params, "mv_deviation_ratio", 0.01);
+    }
+
+    float min_magnitude;  //< pixels, smaller vectors are the encoder's jitter
+    int min_neighbours;   //< moving neighbour cells for a cell to count
+    double deviation_ratio;//< part of the enabled cells that must move
+};
+
+/** Motion detection from the motion vectors exported by the decoder,
+ * without a pixel-domain background model: no scaling, no per-pixel work,
+ * and lighting flicker (coded as residuals with ~zero vectors) is not motion.
+ * The stream must be decoded with DecodeProfile::MotionVectors.
+ * Key frames carry no vectors: the previous description is kept for them.*/
+class MVAlgo
+{
+public:
+    MotionDescription proc(const ZMB::PictureHolder& frame)
+    {
+        const AVFrame* raw = frame.frame_p.get();
+        if (nullptr != raw && (raw->width != mask_w || raw->height != mask_h))
+        {
+            update_mask(raw->width, raw->height);
+        }
+        if (!grid.build(raw, params.min_magnitude))
+            return last;
+
+        int enabled = std::max(1, grid.enabled_cells());
+        Poco::Int64 active = grid.active_cells(params.min_neighbours);
+        Poco::Int64 level = (Poco::Int64)std::ceil(params.deviation_ratio * enabled);
+        last = frame_treshold_track.track((active > level)? 1 : (active < level? -1 : 0));
+        last.pixel_ratio = (float)active / (float)enabled;
+        return last;
+    }
+
+    /** Image-resolution CV_8UC1 mask, non-zero: detection enabled. Empty: the whole frame.*/
+    void set_zone_mask(const cv::Mat& mask)
+    {
+        zone_mask = mask;
+        mask_w = mask_h = -1;
+    }
+
+    /** Bind the triggers to the stream's clock.*/
+    void set_clock(ZMB::MediaClock* media_clock)
+        { frame_treshold_track.set_clock(media_clock); }
+
+    MVParams params;
+    ZMBEntities::MotionVectorGrid grid;
+
+private:
+    void update_mask(int width, int height)
+    {
+        mask_w = width;
+        mask_h = height;
+        if (zone_mask.empty() || zone_mask.cols != width || zone_mask.rows != height)
+            grid.set_mask(nullptr, width, height, 0);
+        else
+            grid.set_mask(zone_mask.data, width, height, (int)zone_mask.step[0]);
+    }
+
+    int mask_w = -1;
+    int mask_h = -1;
+    cv::Mat zone_mask;
+    MotionDescription last;
+    MotionDelayedTrigger frame_treshold_track;
+};
+
+}//namespace CVBGS
+
+namespace ZMBEntities {
+
+class MovementDetector
+{
+public:
+    enum DetectionMode{FULL_FRAME,
+                       POLY_IGNORE_ZONES,
+                       POLY_INTEREST_ZONES,
+                       RECTANGLE_INTEREST_ZONE};
+
+    enum Backend{MOG2_BACKEND, //< background subtraction on downscaled pictures
+                 MV_BACKEND};  //< decoder's motion vectors, see CVBGS::MVAlgo
+
+    MovementDetector() : mode(FULL_FRAME), backend(MOG2_BACKEND)
+    {
+        need_mask_update = true;
+        camera_id = 0;
+        last_state = CVBGS::MotionDescription::Null;
+        event_keepalive_usec = 1000 * 1000;
+        keepalive_due = false;
+        keepalive_timer = ZMB::TimerWheel::INVALID_TIMER;
+        with_tamper = false;
+        snapshot_period_usec = 60 * 1000 * 1000;
+        last_snapshot_usec = 0;
+        //the kernels' instruction set is chosen (and logged) once, before the first frame
+        ZMB::ActiveSimd();
+    }
+
+    ~MovementDetector()
+    {//a graceful restart picks up the freshest model
+        save_snapshot();
+    }
+
+    MovementDetector(const MovementDetector&) = delete;
+    MovementDetector& operator = (const MovementDetector&) = delete;
+    void clear()
+    {
+        need_mask_update = true;
+        mode = DetectionMode::FULL_FRAME;
+        rect_zones_map.clear();
+        ignored_polygonal_zones_map.clear();
+        interest_polygonal_zones_map.clear();
+    }
+
+    bool add_rectangular_enabled_zones(const ZMB::MRegion* rectangles_vector, int len)
+    {
+        auto rvend = rectangles_vector + len;
+        for (auto iter = rectangles_vector; iter != rvend; ++iter)
+        {
+            const ZMB::MRegion& r(*iter);
+            std::shared_ptr<CVBGS::MOG2Algo> mg = std::make_shared<CVBGS::MOG2Algo>();
+            mg->set_clock(&clock);
+            if (r.square() < 128 * 128)
+            {// disable downscaling for little blocks
+               mg->params.with_downscale = false;
+            }
+            BackgroundSnapshot snap;
+            if (nullptr != snapshots && snapshots->load(zone_snapshot_key(r), snap))
+                mg->restore(snap);
+            rect_zones_map[r] = mg;
+        }
+        mode = DetectionMode::RECTANGLE_INTEREST_ZONE;
+        need_mask_update = true;
+        return true;
+    }
+
+    /** Detect only inside the zone's outline (even-odd), image coordinates.*/
+    bool add_polygonal_zone(const glm::ivec2* img_coord_polyline,
+                            int len,
+                            const std::string& zone_name)
+    {
+        if (nullptr == img_coord_polyline || len < 3)
+            return false;
+        interest_polygonal_zones_map[zone_name] = std::vector<glm::ivec2>(img_coord_polyline, img_coord_polyline + len);
+        mode = DetectionMode::POLY_INTEREST_ZONES;
+        need_mask_update = true;
+        return true;
+    }
+
+  typedef std::map<std::string, std::vector<glm::ivec2>> LinesMap;
+  typedef std::pair<std::string, std::vector<glm::ivec2>> NamedLine;
+
+    /** Run the detection on a decoded frame.
+     * @param ts_usec -- frame's media time (from PTS), microseconds;
+     *  if negative, the clock is advanced from the coarse monotonic clock.
+     * @return the state of the motion for the whole frame. */
+    CVBGS::MotionDescription detect(const ZMB::PictureHolder& frame, int64_t ts_usec = -1)
+    {
+        return detect(frame, nullptr, ts_usec);
+    }
+
+    /** Same, the scaled pictures come from the frame's (pyramid).*/
+    CVBGS::MotionDescription detect(ZMB::PicturePyramid& pyramid, int64_t ts_usec = -1)
+    {
+        return detect(*pyramid.base(), &pyramid, ts_usec);
+    }
+
+    CVBGS::MotionDescription detect(const ZMB::PictureHolder& frame, ZMB::PicturePyramid* pyramid, int64_t ts_usec)
+    {
+        //one clock read per frame, all the zones' triggers share it
+        if (ts_usec >= 0)
+            clock.advance_to(ts_usec);
+        else
+            clock.tick();
+
+        if (need_mask_update || ((DetectionMode::POLY_IGNORE_ZONES == mode || DetectionMode::POLY_INTEREST_ZONES == mode)
+                                 && enabled_detection_mask.size() != cv::Size(frame.dimension.width(), frame.dimension.height())))
+        {
+            if (need_mask_update)
+                update_zone_index();
+            update_zone_mask(frame.dimension);
+        }
+        CVBGS::MotionDescription desc;
+        switch (mode) {
+        case DetectionMode::FULL_FRAME:
+        case DetectionMode::POLY_IGNORE_ZONES:
+        case DetectionMode::POLY_INTEREST_ZONES:
+            //the polygonal zones are the algorithms' masks
+            if (MV_BACKEND == backend)
+            {
+                if (nullptr == full_frame_mv)
+                {
+                    full_frame_mv = std::make_shared<CVBGS::MVAlgo>();
+                    full_frame_mv->set_clock(&clock);
+                    full_frame_mv->set_zone_mask(enabled_detection_mask);
+                }
+                desc = full_frame_mv->proc(frame);
+                break;
+            }
+            if (nullptr == full_frame_mog2)
+            {
+                full_frame_mog2 = std::make_shared<CVBGS::MOG2Algo>();
+                full_frame_mog2->set_clock(&clock);
+                full_frame_mog2->set_zone_mask(enabled_detection_mask);
+            }
+            desc = nullptr != pyramid ? full_frame_mog2->proc(*pyramid) : full_frame_mog2->proc(frame);
+            if (with_tamper && tamper.process(full_frame_mog2->thumbnail(), desc.pixel_ratio,
+                                              clock.now(), tamper_changes))
+            {
+                for (const TamperDetector::Change& ch : tamper_changes)
+                    publish_tamper(ch);
+            }
+            if (nullptr != heatmap)
+                heatmap->add(full_frame_mog2->foreground(), clock.wall_usec());
+            break;
+        case DetectionMode::RECTANGLE_INTEREST_ZONE:
+            desc = detect_rect_zones(frame, pyramid);
+            break;
+        default:
+            break;
+        }
+        if (nullptr != snapshots && clock.now() - last_snapshot_usec >= snapshot_period_usec)
+            save_snapshot();
+        publish(desc, MotionEvent::FULL_FRAME_ZONE);
+        return desc;
+    }
+
+    /** Run the rectangles' detectors on their crops of the frame (zero-copy views) and combine them:
+     * the most active of the zones' states and it's type, the moving part of the zones' total area,
+     * the blobs of all the zones in the frame's coordinates, largest first.*/
+    CVBGS::MotionDescription detect_rect_zones(const ZMB::PictureHolder& frame, ZMB::PicturePyramid* pyramid)
+    {
+        //a view keeps it's parent alive: without a pyramid the caller's frame outlives the call anyway
+        ZMB::PictureSharedPtr parent = nullptr != pyramid ? pyramid->base()
+                : ZMB::PictureSharedPtr(&frame, [](const ZMB::PictureHolder*) { });
+        //Null < Calmed < Invoked < Moving
+        static const int rank[] = {0, 2, 3, 1};
+
+        CVBGS::MotionDescription res;
+        double moving_area = 0.0;
+        int64_t total_area = 0;
+        for (const auto& rz : rect_zones_map)
+        {
+            ZMB::PictureHolder view(ZMB::CropView(parent, rz.first));
+            if (view.width() < 2 || view.height() < 2)
+                continue;
+            CVBGS::MotionDescription d = rz.second->proc(view);
+            int64_t area = (int64_t)view.width() * view.height();
+            total_area += area;
+            moving_area += d.pixel_ratio * area;
+            if (rank[d.state] > rank[res.state])
+            {
+                res.state = d.state;
+                res.type = d.type;
+            }
+            ZMBEntities::OffsetBlobs(d.blobs, std::max(0, rz.first.left()), std::max(0, rz.first.bottom()));
+            res.blobs.insert(res.blobs.end(), d.blobs.begin(), d.blobs.end());
+        }
+        res.pixel_ratio = total_area > 0 ? (float)(moving_area / total_area) : 0.0f;
+        std::sort(res.blobs.begin(), res.blobs.end(),
+                  [](const MotionBlob& l, const MotionBlob& r) { return l.area > r.area; });
+        return res;
+    }
+
+    /** Rasterize the polygonal zones to (enabled_detection_mask) of the frame's resolution:
+     * each zone's outline is triangulated and its inside faces are filled, then the mask
+     * goes to the full frame algorithms. The modes without polygons clear it.*/
+    void update_zone_mask(const ZMB::MSize& sz)
+    {
+        need_mask_update = false;
+        bool interest = DetectionMode::POLY_INTEREST_ZONES == mode;
+        if (!interest && DetectionMode::POLY_IGNORE_ZONES != mode)
+        {
+            enabled_detection_mask.release();
+        }
+        else
+        {
+            const LinesMap& zmap(interest ? interest_polygonal_zones_map : ignored_polygonal_zones_map);
+            enabled_detection_mask.create(sz.height(), sz.width(), CV_8UC1);
+            enabled_detection_mask.setTo(interest ? 0 : 255);
+            for (const NamedLine& line : zmap)
+            {
+                zone_workspace.triangulate_outline(line.second.data(), (int)line.second.size());
+                ZoneRasterizer::FillFaces(enabled_detection_mask, zone_workspace, 1.0f, 1.0f, interest ? 255 : 0);
+            }
+        }
+        if (nullptr != full_frame_mv)
+            full_frame_mv->set_zone_mask(enabled_detection_mask);
+        if (nullptr != full_frame_mog2)
+            full_frame_mog2->set_zone_mask(enabled_detection_mask);
+    }
+
+    /** Put all the zones to (zone_index): the rectangles first, in the map's order,
+     * then the interest and the ignored polygons: their outlines (even-odd),
+     * as update_zone_mask() fills them. (zone_names) follows the ids.*/
+    void update_zone_index()
+    {
+        zone_index.clear();
+        zone_names.clear();
+        for (const auto& rz : rect_zones_map)
+        {
+            zone_index.add_rectangle(rz.first);
+            zone_names.push_back(std::string());
+        }
+        for (const LinesMap* zmap : {&interest_polygonal_zones_map, &ignored_polygonal_zones_map})
+        {
+            for (const NamedLine& line : *zmap)
+            {
+                zone_index.add_polygon(line.second.data(), (int)line.second.size());
+                zone_names.push_back(line.first);
+            }
+        }
+        zone_index.build();
+    }
+
+    /** Zones overlapping the blobs of (desc), batched: hits' (query) is the blob's index.
+     * @return the number of the hits appended.*/
+    size_t blob_zones(const CVBGS::MotionDescription& desc, std::vector<ZoneHit>& hits)
+    {
+        if (need_mask_update)
+            update_zone_index();
+        blob_boxes.clear();
+        for (const MotionBlob& b : desc.blobs)
+            blob_boxes.push_back(b.region);
+        return zone_index.query_boxes(blob_boxes.data(), blob_boxes.size(), hits);
+    }
+
+    /** Restore the background models from (store): the full frame's and the rectangle zones'
+     * (each under it's own key, see zone_snapshot_key(), the zones added later are restored too),
+     * and save them there every (snapshot_period_usec) of the stream's time,
+     * so the detection is hot right after a restart or a reconnect.
+     * @return TRUE if a snapshot was found.*/
+    bool attach_snapshots(std::shared_ptr<BackgroundSnapshotStore> store, const std::string& key)
+    {
+        snapshots = store;
+        snapshot_key = key;
+        last_snapshot_usec = clock.now();
+        if (nullptr == snapshots)
+            return false;
+        bool found = false;
+        BackgroundSnapshot snap;
+        for (const auto& rz : rect_zones_map)
+        {
+            if (!snapshots->load(zone_snapshot_key(rz.first), snap))
+                continue;
+            rz.second->restore(snap);
+            found = true;
+        }
+        if (!snapshots->load(snapshot_key, snap))
+            return found;
+        if (nullptr == full_frame_mog2)
+        {
+            full_frame_mog2 = std::make_shared<CVBGS::MOG2Algo>();
+            full_frame_mog2->set_clock(&clock);
+            full_frame_mog2->set_zone_mask(enabled_detection_mask);
+        }
+        full_frame_mog2->restore(snap);
+        return true;
+    }
+
+    /** Queue the backgrounds for writing, no-op without a store or during the warm-up.*/
+    void save_snapshot()
+    {
+        last_snapshot_usec = clock.now();
+        if (nullptr == snapshots)
+            return;
+        if (nullptr != full_frame_mog2)
+        {
+            BackgroundSnapshot snap = full_frame_mog2->snapshot();
+            snap.ts_usec = clock.now();
+            snapshots->submit(snapshot_key, snap);
+        }
+        for (const auto& rz : rect_zones_map)
+        {
+            BackgroundSnapshot snap = rz.second->snapshot();
+            snap.ts_usec = clock.now();
+            snapshots->submit(zone_snapshot_key(rz.first), snap);
+        }
+    }
+
+    /** Store's key of a rectangle zone's model: "<snapshot_key>.rect_<x>_<y>_<w>_<h>".*/
+    std::string zone_snapshot_key(const ZMB::MRegion& r) const
+    {
+        return snapshot_key + ".rect_" + std::to_string(r.left()) + "_" + std::to_string(r.bottom())
+                + "_" + std::to_string(r.width()) + "_" + std::to_string(r.height());
+    }
+
+    void publish_tamper(const TamperDetector::Change& change)
+    {
+        std::cerr << "Camera " << camera_id << " tamper " << (int)change.kind
+                  << (change.active ? " raised" : " cleared") << ", score: " << change.score << "\n";
+        if (nullptr == event_bus)
+            return;
+        MotionEvent ev;
+        ev.camera = camera_id;
+        ev.zone = MotionEvent::TAMPER_ZONE;
+        ev.type = (uint8_t)(MotionEvent::TAMPER_BASE + change.kind);
+        ev.state = change.active ? MotionEvent::Invoked : MotionEvent::Calmed;
+        ev.ts_usec = clock.wall_usec();
+        ev.pixel_ratio = change.score;
+        event_bus->publish(ev);
+    }
+
+    /** Send the state to the (event_bus) on changes and, while the motion is active,
+     * once per (event_keepalive_usec) of the stream's time.*/
+    void publish(const CVBGS::MotionDescription& desc, uint16_t zone)
+    {
+        bool changed = desc.state != last_state;
+        bool active = CVBGS::MotionDescription::Invoked == desc.state
+                || CVBGS::MotionDescription::Moving == desc.state;
+        last_state = desc.state;
+        if (nullptr == event_bus || !(changed || (active && keepalive_due)))
+            return;
+
+        MotionEvent ev;
+        ev.camera = camera_id;
+        ev.zone = zone;
+        ev.type = (uint8_t)desc.type;
+        ev.state = (uint8_t)desc.state;
+        ev.ts_usec = clock.wall_usec();
+        ev.pixel_ratio = desc.pixel_ratio;
+        event_bus->publish(ev);
+
+        keepalive_due = false;
+        clock.timers().cancel(keepalive_timer);
+        keepalive_timer = clock.schedule_in(event_keepalive_usec, [this]() { keepalive_due = true; });
+    }
+
+    DetectionMode mode;
+    Backend backend;//< set before the first detect()
+    std::shared_ptr<CVBGS::MOG2Algo> full_frame_mog2;
+    std::shared_ptr<CVBGS::MVAlgo> full_frame_mv;
+    std::map<ZMB::MRegion, std::shared_ptr<CVBGS::MOG2Algo>> rect_zones_map;
+
+  std::map<std::string/*name*/, std::vector<glm::ivec2>/*outline*/>
+        ignored_polygonal_zones_map,
+        interest_polygonal_zones_map;
+    cv::Mat enabled_detection_mask;
+    bool need_mask_update;
+    JVa::Workspace zone_workspace;
+    ZoneIndex zone_index;//< all the zones, for the blobs' lookups
+    std::vector<std::string> zone_names;//< by the zone_index's ids, empty for the rectangles
+    std::vector<ZMB::MRegion> blob_boxes;
+
+    uint32_t camera_id;//< goes to the published events
+    std::shared_ptr<MotionEventBus> event_bus;//< may be shared by all the detectors, NULL by default
+    CVBGS::MotionDescription::State last_state;
+    int64_t event_keepalive_usec;//< repeat period of an active state's event
+
+    /** Stream's time: drives the triggers' delays and the timers.*/
+    ZMB::MediaClock clock;
+
+    /** Camera tamper detection on the full frame MOG2's thumbnails (MOG2_BACKEND only).*/
+    bool with_tamper;
+    TamperDetector tamper;
+
+    /** Where the camera's activity goes (MOG2_BACKEND only), NULL: not collected.
+     * The history is queried with heatmap->query() or MotionHeatmap::QueryStored().*/
+    std::unique_ptr<MotionHeatmap> heatmap;
+
+    std::shared_ptr<BackgroundSnapshotStore> snapshots;//< NULL: no persistence
+    std::string snapshot_key;
+    int64_t snapshot_period_usec;
+
+private:
+    bool keepalive_due;
+    ZMB::TimerWheel::TimerId keepalive_timer;
+    int64_t last_snapshot_usec;
+    std::vector<TamperDetector::Change> tamper_changes;
+
+};
+
+}//namespace ZMBEntities
+
+#endif // MOVEMENT_DETECTOR_H
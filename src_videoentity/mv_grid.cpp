@@ -0,0 +1,120 @@
+#include "mv_grid.h"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C"
+{
+#include <libavutil/frame.h>
+#include <libavutil/motion_vector.h>
+}
+
+namespace ZMBEntities {
+
+void MotionVectorGrid::resize(int width, int height)
+{
+    int c = (width + CELL - 1) / CELL;
+    int r = (height + CELL - 1) / CELL;
+    if (c == cols && r == rows)
+        return;
+    cols = c;
+    rows = r;
+    cells.assign((size_t)cols * rows, 0);
+    if (!mask_cells.empty() && mask_cells.size() != cells.size())
+    {//the mask was set for other dimensions
+        mask_cells.clear();
+    }
+    enabled_cnt = mask_cells.empty() ? cols * rows
+                                     : (int)std::count(mask_cells.begin(), mask_cells.end(), 1);
+}
+
+bool MotionVectorGrid::build(const AVFrame* frame, float min_magnitude)
+{
+    if (nullptr == frame)
+        return false;
+    resize(frame->width, frame->height);
+
+    AVFrameSideData* sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
+    if (nullptr == sd)
+        return false;
+
+    std::fill(cells.begin(), cells.end(), 0);
+    const AVMotionVector* mvs = (const AVMotionVector*)sd->data;
+    size_t n = sd->size / sizeof(AVMotionVector);
+    const int min_sq = (int)(min_magnitude * min_magnitude);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const AVMotionVector& mv(mvs[i]);
+        int dx = mv.dst_x - mv.src_x;
+        int dy = mv.dst_y - mv.src_y;
+        if (dx * dx + dy * dy < min_sq)
+            continue;
+
+        //(dst_x, dst_y) is the block's center
+        int x0 = std::max(0, (mv.dst_x - mv.w / 2) / CELL);
+        int y0 = std::max(0, (mv.dst_y - mv.h / 2) / CELL);
+        int x1 = std::min(cols - 1, (mv.dst_x + mv.w / 2 - 1) / CELL);
+        int y1 = std::min(rows - 1, (mv.dst_y + mv.h / 2 - 1) / CELL);
+        if (x0 > x1 || y0 > y1)
+            continue;//outside of the picture
+        for (int y = y0; y <= y1; ++y)
+        {
+            std::memset(&cells[(size_t)y * cols + x0], 1, x1 - x0 + 1);
+        }
+    }
+    return true;
+}
+
+void MotionVectorGrid::set_mask(const uint8_t* mask, int width, int height, int stride)
+{
+    mask_cells.clear();
+    resize(width, height);
+    if (nullptr == mask)
+    {
+        enabled_cnt = cols * rows;
+        return;
+    }
+
+    mask_cells.assign((size_t)cols * rows, 0);
+    for (int y = 0; y < height; ++y)
+    {
+        const uint8_t* line = mask + (size_t)y * stride;
+        uint8_t* mline = &mask_cells[(size_t)(y / CELL) * cols];
+        for (int x = 0; x < width; ++x)
+        {
+            if (0 != line[x])
+                mline[x / CELL] = 1;
+        }
+    }
+    enabled_cnt = (int)std::count(mask_cells.begin(), mask_cells.end(), 1);
+}
+
+int MotionVectorGrid::active_cells(int min_neighbours) const
+{
+    int cnt = 0;
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            size_t idx = (size_t)y * cols + x;
+            if (0 == cells[idx] || (!mask_cells.empty() && 0 == mask_cells[idx]))
+                continue;
+
+            int nb = 0;
+            for (int ny = std::max(0, y - 1); ny <= std::min(rows - 1, y + 1); ++ny)
+            {
+                for (int nx = std::max(0, x - 1); nx <= std::min(cols - 1, x + 1); ++nx)
+                {
+                    nb += cells[(size_t)ny * cols + nx];
+                }
+            }
+            //the cell itself is counted in (nb)
+            if (nb - 1 >= min_neighbours)
+                ++cnt;
+        }
+    }
+    return cnt;
+}
+
+}//ZMBEntities
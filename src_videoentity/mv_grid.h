@@ -0,0 +1,53 @@
+#ifndef MV_GRID_H
+#define MV_GRID_H
+
+#include <vector>
+#include <cstdint>
+
+struct AVFrame;
+
+namespace ZMBEntities {
+
+/** Macroblock-level motion map of a decoded frame, made of the motion vectors
+ * the decoder exports as frame's side data (AV_FRAME_DATA_MOTION_VECTORS,
+ * the codec must be opened with flags2 +export_mvs, see DecodeProfile::MotionVectors).
+ *
+ * A cell of CELL x CELL pixels is moving if any block covering it was predicted
+ * with a displacement of at least (min_magnitude) pixels.
+ * Lighting changes are coded as residuals with ~zero vectors, so they don't move cells.
+ * Key frames have no vectors, build() returns FALSE for them.*/
+class MotionVectorGrid
+{
+public:
+    static constexpr int CELL = 16;
+
+    MotionVectorGrid() : cols(0), rows(0), enabled_cnt(0) { }
+
+    /** Fill the cells from the frame's vectors.
+     * @return FALSE if the frame has no motion vectors side data.*/
+    bool build(const AVFrame* frame, float min_magnitude);
+
+    /** Set the zones mask of the image's resolution (non-zero: detection enabled),
+     * a cell is enabled if any of its pixels is. NULL mask: all enabled.*/
+    void set_mask(const uint8_t* mask, int width, int height, int stride);
+
+    /** Moving enabled cells having at least (min_neighbours) moving 8-connected neighbours
+     * (single cells are mostly the encoder's noise).*/
+    int active_cells(int min_neighbours) const;
+
+    int enabled_cells() const {return enabled_cnt;}
+
+    int cols;
+    int rows;
+    std::vector<uint8_t> cells;     //< 1: moving, row-major (cols x rows)
+    std::vector<uint8_t> mask_cells;//< 1: enabled, empty: all enabled
+
+private:
+    void resize(int width, int height);
+
+    int enabled_cnt;
+};
+
+}//ZMBEntities
+
+#endif // MV_GRID_H
@@ -0,0 +1,286 @@
+#include "offline_scanner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <cstdio>
+#include <boost/filesystem.hpp>
+
+#include "../external/avcpp/src/av.h"
+#include "../external/avcpp/src/formatcontext.h"
+#include "../external/avcpp/src/codec.h"
+#include "../external/avcpp/src/codeccontext.h"
+#include "../external/avcpp/src/packet.h"
+#include "../external/avcpp/src/frame.h"
+
+extern "C"
+{
+#include <libavutil/avutil.h>
+#include <libavutil/mathematics.h>
+}
+
+namespace ZMBEntities {
+
+static const char* StateName(CVBGS::MotionDescription::State state)
+{
+    static const char* names[] = {"Null", "Invoked", "Moving", "Calmed"};
+    return names[(int)state];
+}
+
+static const char* TypeName(CVBGS::MotionDescription::Type type)
+{
+    static const char* names[] = {"Uncertain", "Blick", "Motion"};
+    return names[(int)type];
+}
+
+//-----------------------------------------------------------------------------
+OfflineFileScan::OfflineFileScan(const std::string& file_path, const OfflineScanParams& params)
+    : input_path(file_path), params(params), frames_cnt(0)
+{
+    boost::filesystem::path out(params.output_dir);
+    out /= boost::filesystem::path(file_path).filename().string() + ".timeline.tsv";
+    output_path = out.string();
+}
+
+bool OfflineFileScan::run()
+{
+    std::error_code ec;
+    av::FormatContext ictx;
+    ictx.openInput(input_path, ec);
+    if (ec)
+    {
+        std::cerr << "Can't open input " << input_path << "\n";
+        return false;
+    }
+    ictx.findStreamInfo(ec);
+    if (ec)
+    {
+        std::cerr << "Can't find streams: " << ec << ", " << ec.message() << std::endl;
+        return false;
+    }
+
+    ssize_t videoStream = -1;
+    av::Stream vst;
+    for (size_t i = 0; i < ictx.streamsCount(); ++i)
+    {
+        auto st = ictx.stream(i);
+        if (st.mediaType() == AVMEDIA_TYPE_VIDEO)
+        {
+            videoStream = i;
+            vst = st;
+            break;
+        }
+    }
+    if (vst.isNull() || !vst.isValid())
+    {
+        std::cerr << "Video stream not found in " << input_path << "\n";
+        return false;
+    }
+
+    av::VideoDecoderContext vdec(vst);
+    vdec.setCodec(av::findDecodingCodec(vdec.raw()->codec_id));
+    vdec.setRefCountedFrames(true);
+    DecodeProfileParams profile;
+    profile.profile = params.decode_profile;
+    ApplyDecodeProfile(vdec.raw(), profile);
+    DecoderThreadingPolicy policy = params.threading;
+    if (params.decoder_threads > 0)
+    {
+        policy.mode = DecoderThreadingPolicy::Fixed;
+        policy.fixed_threads = params.decoder_threads;
+    }
+    AVRational rate = vst.raw()->avg_frame_rate;
+    double fps = (rate.num > 0 && rate.den > 0) ? av_q2d(rate) : 0.0;
+    DecoderThreadsLease lease;
+    DecoderThreading dt = policy.choose(vdec.raw(), fps, lease);
+    std::string threads = dt.threads_option();
+    {//the codec spawns it's worker threads there
+        DecoderOpenScope scope(dec_stats);
+        vdec.open({{"threads", threads.c_str()}, {"thread_type", dt.thread_type.c_str()}}, av::Codec(), ec);
+    }
+    if (ec)
+    {
+        std::cerr << "Can't open codec for " << input_path << "\n";
+        return false;
+    }
+
+    MovementDetector detector;
+    detector.full_frame_mog2 = std::make_shared<CVBGS::MOG2Algo>();
+    detector.full_frame_mog2->params.set_params(params.bgs_params);
+    detector.full_frame_mog2->set_clock(&detector.clock);
+    if (DecodeProfile::MotionVectors == params.decode_profile)
+    {
+        detector.backend = MovementDetector::MV_BACKEND;
+        detector.full_frame_mv = std::make_shared<CVBGS::MVAlgo>();
+        detector.full_frame_mv->params.set_params(params.bgs_params);
+        detector.full_frame_mv->set_clock(&detector.clock);
+    }
+
+    const AVRational tb = vst.raw()->time_base;
+    const int64_t duration_usec = ictx.raw()->duration > 0 ? ictx.raw()->duration : 0;
+    bool started = false;
+    int64_t first_usec = 0;
+    int64_t last_usec = 0;
+    CVBGS::MotionDescription::State last_state = CVBGS::MotionDescription::Null;
+    entries.clear();
+
+    auto fn_on_frame = [&](av::VideoFrame& frame)
+    {
+        AVFrame* raw = frame.raw();
+        int64_t pts = raw->best_effort_timestamp;
+        if (AV_NOPTS_VALUE == pts)
+            pts = raw->pts;
+        int64_t ts_usec = (AV_NOPTS_VALUE == pts) ? last_usec + 1
+                                                  : av_rescale_q(pts, tb, AV_TIME_BASE_Q);
+        if (!started)
+        {//the clock starts with the stream
+            started = true;
+            first_usec = ts_usec;
+            detector.clock.reset(0);
+        }
+        last_usec = ts_usec;
+        //the detector runs on the time from the stream's start: the PTS may be negative,
+        //and a negative time means "no PTS" to it (the monotonic clock)
+        const int64_t stream_usec = std::max<int64_t>(0, ts_usec - first_usec);
+
+        //shares the decoded buffers, no copying
+        ZMB::PictureHolder pic(ZMB::AVFrameUniquePtr(av_frame_clone(raw)));
+        CVBGS::MotionDescription desc = detector.detect(pic, stream_usec);
+        ++frames_cnt;
+
+        if (desc.state != last_state)
+        {
+            entries.push_back(TimelineEntry{ts_usec, desc});
+            last_state = desc.state;
+        }
+        if (onProgress && duration_usec > 0 && 0 == (frames_cnt & 63))
+            onProgress(std::min(1.0f, (float)stream_usec / (float)duration_usec));
+    };
+
+    while (!(isCancelled && isCancelled()))
+    {
+        av::Packet pkt = ictx.readPacket(ec);
+        if (ec || !pkt)
+            break;
+        if (pkt.streamIndex() != videoStream)
+            continue;
+
+        dec_stats.begin();
+        av::VideoFrame frame = vdec.decode(pkt, ec);
+        dec_stats.end(!ec && frame);
+        if (ec)
+        {
+            std::cerr << "Decoding error: " << ec << ", " << ec.message() << std::endl;
+            ec.clear();
+            continue;
+        }
+        if (frame)
+            fn_on_frame(frame);
+    }
+
+    //frames delayed by the frame threading
+    while (!(isCancelled && isCancelled()))
+    {
+        dec_stats.begin();
+        av::VideoFrame frame = vdec.decode(av::Packet(), ec);
+        dec_stats.end(!ec && frame);
+        if (ec || !frame)
+            break;
+        fn_on_frame(frame);
+    }
+
+    if (onProgress)
+        onProgress(1.0f);
+    return write_timeline();
+}
+
+bool OfflineFileScan::write_timeline()
+{
+    std::ofstream out(output_path, std::ios::out | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Can't write " << output_path << "\n";
+        return false;
+    }
+    out << "# seconds\tstate\ttype\tpixel_ratio\n";
+    char line[128];
+    for (const TimelineEntry& e : entries)
+    {
+        snprintf(line, sizeof(line), "%.6f\t%s\t%s\t%.4f\n",
+                 e.ts_usec * 1e-6, StateName(e.desc.state), TypeName(e.desc.type), e.desc.pixel_ratio);
+        out << line;
+    }
+    return (bool)out;
+}
+
+//-----------------------------------------------------------------------------
+class OfflineScanner::Worker : public Poco::Task
+{
+public:
+    Worker(const std::string& name, OfflineScanner& owner)
+        : Poco::Task(name), owner(owner) { }
+
+    void runTask() override
+    {
+        while (!isCancelled())
+        {
+            size_t idx = owner.next_file.fetch_add(1);
+            if (idx >= owner.files.size())
+                break;
+
+            OfflineFileScan scan(owner.files[idx], owner.params);
+            scan.onProgress = [this](float p) { setProgress(p); };
+            scan.isCancelled = [this]() { return isCancelled(); };
+
+            bool ok = scan.run();
+            if (!ok)
+                owner.failures.fetch_add(1);
+            if (owner.onFileDone)
+                owner.onFileDone(scan, ok);
+        }
+    }
+
+private:
+    OfflineScanner& owner;
+};
+
+OfflineScanner::OfflineScanner(const OfflineScanParams& params)
+    : params(params), next_file(0), failures(0)
+{
+    if (0 == this->params.workers)
+        this->params.workers = std::max(1u, std::thread::hardware_concurrency());
+
+    pool.reset(new Poco::ThreadPool(1, (int)this->params.workers));
+    manager.reset(new Poco::TaskManager(*pool));
+}
+
+OfflineScanner::~OfflineScanner()
+{
+    cancel();
+    manager->joinAll();
+}
+
+void OfflineScanner::add(const std::string& file_path)
+{
+    files.push_back(file_path);
+}
+
+size_t OfflineScanner::run()
+{
+    next_file = 0;
+    failures = 0;
+    size_t n = std::min<size_t>(params.workers, files.size());
+    for (size_t c = 0; c < n; ++c)
+    {
+        manager->start(new Worker("offline_scan" + std::to_string(c), *this));
+    }
+    manager->joinAll();
+    return failures.load();
+}
+
+void OfflineScanner::cancel()
+{
+    manager->cancelAll();
+}
+
+}//ZMBEntities
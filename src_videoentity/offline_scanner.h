@@ -0,0 +1,117 @@
+#ifndef OFFLINE_SCANNER_H
+#define OFFLINE_SCANNER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <Poco/Task.h>
+#include <Poco/TaskManager.h>
+#include <Poco/ThreadPool.h>
+#include "movement_detector.h"
+#include "decoder_policy.h"
+
+namespace ZMBEntities {
+
+/** One line of the events timeline.*/
+struct TimelineEntry
+{
+    int64_t ts_usec;//< media time of the frame (from PTS)
+    CVBGS::MotionDescription desc;
+};
+
+struct OfflineScanParams
+{
+    std::string output_dir = ".";
+    Json::Value bgs_params;   //< CVBGS::BGSParams::set_params() values
+    int decoder_threads = 0;  //< 0: (threading) policy chooses, shared DecoderCoreBudget
+    DecoderThreadingPolicy threading;
+    DecodeProfile decode_profile = DecodeProfile::Analysis;//< frames are only seen by the detector
+    unsigned workers = 0;     //< parallel files, 0: number of CPU cores
+};
+
+/** Analysis of one recorded file faster than real time.
+ * All the timing (triggers' delays, timers) is driven by the frames' PTS,
+ * so the result does not depend on the processing speed.
+ * The decoder's threads are leased from the DecoderCoreBudget, so the parallel
+ * scans share the cores with the live decoders.
+ * The state changes are written to "<output_dir>/<file name>.timeline.tsv":
+ * @verbatim
+   # seconds  state  type  pixel_ratio
+   12.480000  Invoked  Blick  0.0071
+ * @endverbatim
+ */
+class OfflineFileScan
+{
+public:
+    typedef std::function<void(float progress)> OnProgressFunc;
+    typedef std::function<bool()> IsCancelledFunc;
+
+    OfflineFileScan(const std::string& file_path, const OfflineScanParams& params);
+
+    /** Decode and analyze the whole file, then write the timeline.
+     * @return FALSE on errors. */
+    bool run();
+
+    const std::string& path() const {return input_path;}
+    const std::string& timeline_path() const {return output_path;}
+    const std::vector<TimelineEntry>& timeline() const {return entries;}
+    uint64_t frames() const {return frames_cnt;}
+    const DecoderStats& decoder_stats() const {return dec_stats;}
+
+    OnProgressFunc onProgress; //< position in the file [0.0, 1.0]
+    IsCancelledFunc isCancelled;
+
+private:
+    bool write_timeline();
+
+    std::string input_path;
+    std::string output_path;
+    OfflineScanParams params;
+    std::vector<TimelineEntry> entries;
+    uint64_t frames_cnt;
+    DecoderStats dec_stats;
+};
+
+/** Scans a set of files in parallel with a Poco::TaskManager:
+ * (workers) tasks take the files one by one from the shared list,
+ * each file is analyzed sequentially (the state machine needs the frames in order).
+ * Task's progress is the position in the current file.*/
+class OfflineScanner
+{
+public:
+    typedef std::function<void(const OfflineFileScan& scan, bool ok)> OnFileDoneFunc;
+
+    explicit OfflineScanner(const OfflineScanParams& params);
+    ~OfflineScanner();
+
+    void add(const std::string& file_path);
+
+    /** Start the workers and wait for them.
+     * @return number of files that failed.*/
+    size_t run();
+
+    /** Stop the workers after their current files.*/
+    void cancel();
+
+    /** Called from the worker's thread, must be thread-safe.*/
+    OnFileDoneFunc onFileDone;
+
+    Poco::TaskManager& taskManager() {return *manager;}
+
+private:
+    class Worker;
+
+    OfflineScanParams params;
+    std::vector<std::string> files;
+    std::atomic<size_t> next_file;
+    std::atomic<size_t> failures;
+    std::unique_ptr<Poco::ThreadPool> pool;
+    std::unique_ptr<Poco::TaskManager> manager;
+};
+
+}//ZMBEntities
+
+#endif // OFFLINE_SCANNER_H
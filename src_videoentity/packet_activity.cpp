@@ -0,0 +1,66 @@
+#include "packet_activity.h"
+
+namespace ZMBEntities {
+
+void PacketActivityEstimator::reset()
+{
+    fast = 0.0;
+    baseline = 0.0;
+    packets = 0;
+    last_tristate = 0;
+}
+
+int PacketActivityEstimator::push(size_t packet_size, bool is_key)
+{
+    if (is_key || 0 == packet_size)
+        return last_tristate = 0;
+
+    double sz = (double)packet_size;
+    if (0 == packets)
+    {
+        fast = sz;
+        baseline = sz;
+    }
+    ++packets;
+    fast += params.fast_alpha * (sz - fast);
+
+    if (packets < params.warmup_packets)
+    {//learn the baseline faster
+        baseline += (1.0 / packets) * (sz - baseline);
+        return last_tristate = 0;
+    }
+
+    double ratio = activity();
+    if (ratio > params.rise_ratio)
+        return last_tristate = 1;
+
+    //the baseline follows only the calm scene (and the slow bitrate changes)
+    baseline += params.slow_alpha * (sz - baseline);
+    if (ratio < params.fall_ratio)
+        return last_tristate = -1;
+    return last_tristate = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool PacketActivityGate::push(size_t packet_size, bool is_key, int64_t ts_usec)
+{
+    int tristate = estimator.push(packet_size, is_key);
+    if (!estimator.is_warm())
+    {//decode while learning, the detector needs the warm-up too
+        open_state = true;
+        last_rise_usec = ts_usec;
+        return true;
+    }
+    if (1 == tristate)
+    {
+        open_state = true;
+        last_rise_usec = ts_usec;
+    }
+    else if (open_state && ts_usec - last_rise_usec > hold_usec)
+    {
+        open_state = false;
+    }
+    return open_state;
+}
+
+}//ZMBEntities
@@ -0,0 +1,84 @@
+#ifndef PACKET_ACTIVITY_H
+#define PACKET_ACTIVITY_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace ZMBEntities {
+
+struct PacketActivityParams
+{
+    double fast_alpha = 0.25;   //< EWMA weight of the short-term packet size (~4 packets)
+    double slow_alpha = 0.005;  //< EWMA weight of the idle baseline (~200 packets)
+    double rise_ratio = 1.8;    //< short-term/baseline above it: activity rises (+1)
+    double fall_ratio = 1.25;   //< below it: activity falls (-1), between: no changes (0)
+    unsigned warmup_packets = 25;//< the baseline is learnt first, tristate is 0 meanwhile
+};
+
+/** Zero-decode scene activity estimation from the compressed stream.
+ * The size of an inter-coded (non-key) packet is roughly proportional to the
+ * amount of the changed macroblocks, so with a static scene it stays near the
+ * encoder's baseline and it grows with anything moving in front of the camera.
+ *
+ * Keeps the running means of the non-key packets' sizes:
+ * a fast one (current activity) and a slow one (the idle baseline, updated only
+ * while there is no activity, so a long motion does not become the baseline).
+ * Key frames are ignored: they are large regardless of the scene.
+ *
+ * The output is a tristate {-1, 0, 1} with the semantics of
+ * CVBGS::MotionDelayedTrigger::track(), so it can feed the same triggers.
+ * Not thread-safe: one per stream, called from the reading thread.*/
+class PacketActivityEstimator
+{
+public:
+    PacketActivityEstimator() { reset(); }
+    explicit PacketActivityEstimator(const PacketActivityParams& p) : params(p) { reset(); }
+
+    /** @return tristate for this packet.*/
+    int push(size_t packet_size, bool is_key);
+
+    void reset();
+
+    /** short-term mean / baseline, 1.0 for a static scene.*/
+    double activity() const {return (baseline > 0.0) ? fast / baseline : 1.0;}
+    int tristate() const {return last_tristate;}
+    bool is_warm() const {return packets >= params.warmup_packets;}
+
+    PacketActivityParams params;
+
+private:
+    double fast;
+    double baseline;
+    unsigned packets;
+    int last_tristate;
+};
+
+/** Opens full decoding (and the MOG2 after it) only while the stream is active.
+ * Opens on a rising tristate and stays open (hold_usec) after the last one,
+ * so a detection in progress is not cut by a short lull.
+ * While closed the caller keeps the packets since the last key frame and
+ * decodes them on opening, so the decoder starts from a key frame and the
+ * detector gets the frames that triggered the opening.*/
+class PacketActivityGate
+{
+public:
+    PacketActivityGate() : hold_usec(3 * 1000 * 1000), open_state(false), last_rise_usec(0) { }
+
+    /** @return TRUE if the packet should be decoded.*/
+    bool push(size_t packet_size, bool is_key, int64_t ts_usec);
+
+    bool is_open() const {return open_state;}
+    void force_open(int64_t ts_usec) { open_state = true; last_rise_usec = ts_usec; }
+    void reset() { estimator.reset(); open_state = false; last_rise_usec = 0; }
+
+    PacketActivityEstimator estimator;
+    int64_t hold_usec;
+
+private:
+    bool open_state;
+    int64_t last_rise_usec;
+};
+
+}//ZMBEntities
+
+#endif // PACKET_ACTIVITY_H
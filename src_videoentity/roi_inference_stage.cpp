@@ -0,0 +1,217 @@
+#include "roi_inference_stage.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+extern "C"
+{
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+namespace ZMBEntities {
+
+RoiInferenceStage::RoiInferenceStage(const std::string& name, const RoiInferenceParams& params)
+    : Poco::Task(name), params(params),
+      requests(params.queue_capacity, ZMB::CancellableQueue<Request>::RefuseNewest)
+{
+
+}
+
+RoiInferenceStage::~RoiInferenceStage()
+{
+
+}
+
+bool RoiInferenceStage::load()
+{
+    try
+    {
+        net = cv::dnn::readNet(params.model_path, params.config_path);
+    }
+    catch (const cv::Exception& ex)
+    {
+        std::cerr << "Can't load " << params.model_path << ": " << ex.what() << std::endl;
+        return false;
+    }
+    if (net.empty())
+    {
+        std::cerr << "Can't load " << params.model_path << "\n";
+        return false;
+    }
+    net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    return true;
+}
+
+bool RoiInferenceStage::take_token(uint32_t camera, Clock::time_point now)
+{
+    auto iter = buckets.find(camera);
+    if (buckets.end() == iter)
+        iter = buckets.emplace(camera, TokenBucket{params.camera_burst, now}).first;
+
+    TokenBucket& b(iter->second);
+    double elapsed = std::chrono::duration<double>(now - b.last).count();
+    b.tokens = std::min(params.camera_burst, b.tokens + elapsed * params.camera_rate);
+    b.last = now;
+    if (b.tokens < 1.0)
+        return false;
+    b.tokens -= 1.0;
+    return true;
+}
+
+bool RoiInferenceStage::submit(uint32_t camera, int64_t ts_usec, const ZMB::PictureSharedPtr& frame,
+                               const ZMB::MRegion& region, uint32_t track_id)
+{
+    if (nullptr == frame || !region.valid())
+        return false;
+
+    Clock::time_point now = Clock::now();
+    {
+        std::unique_lock<std::mutex> lk(buckets_mutex);
+        if (!take_token(camera, now))
+        {
+            counters.rate_limited.fetch_add(1);
+            return false;
+        }
+    }
+    //the crops are already stale when the stage is that far behind: refuse the new ones
+    size_t fill = 0;
+    if (!requests.push(Request{camera, ts_usec, frame, region, track_id, now}, &fill))
+    {
+        counters.dropped.fetch_add(1);
+        return false;
+    }
+    counters.submitted.fetch_add(1);
+    setProgress((float)fill / (float)params.queue_capacity);
+    return true;
+}
+
+bool RoiInferenceStage::crop(const Request& req, cv::Mat& dst)
+{
+    const ZMB::PictureHolder& pic(*req.frame);
+    if (pic.dimension.width() <= 0)
+        return false;
+
+    //enlarge by the margin, the view clips it and aligns it to the chroma grid
+    const ZMB::MRegion& r(req.region);
+    int mx = (int)(r.width() * params.margin);
+    int my = (int)(r.height() * params.margin);
+    int x0 = r.left() - mx;
+    int y0 = r.bottom() - my;
+    ZMB::PictureHolder view(ZMB::CropView(req.frame, x0, y0, r.width() + 2 * mx, r.height() + 2 * my));
+    if (view.width() < 2 || view.height() < 2)
+        return false;
+
+    dst.create(params.input_height, params.input_width, CV_8UC3);
+    SwsContext* ctx = sws_getCachedContext(sws.release(), view.width(), view.height(), (AVPixelFormat)view.format,
+                                           params.input_width, params.input_height, AV_PIX_FMT_BGR24,
+                                           SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+    sws.reset(ctx);
+    if (nullptr == ctx)
+        return false;
+
+    uint8_t* dst_data[4] = {dst.data, nullptr, nullptr, nullptr};
+    int dst_strides[4] = {(int)dst.step[0], 0, 0, 0};
+    sws_scale(ctx, view.dataSlicesArray.data(), view.stridesArray.data(), 0, view.height(), dst_data, dst_strides);
+    return true;
+}
+
+void RoiInferenceStage::infer(std::vector<Request>& batch)
+{
+    Clock::time_point start = Clock::now();
+    std::vector<cv::Mat> crops;
+    std::vector<const Request*> sent;
+    crops.reserve(batch.size());
+    for (const Request& req : batch)
+    {
+        cv::Mat m;
+        if (!crop(req, m))
+            continue;
+        crops.push_back(m);
+        sent.push_back(&req);
+    }
+    if (crops.empty())
+        return;
+
+    cv::Mat out;
+    try
+    {
+        cv::Mat blob = cv::dnn::blobFromImages(crops, params.scale,
+                                               cv::Size(params.input_width, params.input_height),
+                                               params.mean, params.swap_rb, false);
+        net.setInput(blob);
+        out = net.forward();
+    }
+    catch (const cv::Exception& ex)
+    {
+        std::cerr << "Inference failed: " << ex.what() << std::endl;
+        return;
+    }
+    counters.batches.fetch_add(1);
+    counters.inferred.fetch_add(crops.size());
+
+    //one row of class scores per crop
+    cv::Mat scores = out.reshape(1, (int)crops.size());
+    for (size_t c = 0; c < sent.size(); ++c)
+    {
+        cv::Point best;
+        double best_score = 0.0;
+        cv::minMaxLoc(scores.row((int)c), nullptr, &best_score, nullptr, &best);
+
+        const Request& req(*sent[c]);
+        uint64_t lat = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(start - req.enqueued).count();
+        counters.latency_usec_sum.fetch_add(lat);
+        uint64_t prev = counters.latency_usec_max.load();
+        while (lat > prev && !counters.latency_usec_max.compare_exchange_weak(prev, lat)) { }
+
+        RoiResult res;
+        res.camera = req.camera;
+        res.ts_usec = req.ts_usec;
+        res.region = req.region;
+        res.track_id = req.track_id;
+        res.class_id = best.x;
+        res.score = (float)best_score;
+        res.queue_latency_ms = lat / 1000.0;
+        if (nullptr != onResult)
+            onResult(res);
+    }
+}
+
+void RoiInferenceStage::runTask()
+{
+    std::vector<Request> batch;
+    batch.reserve(params.max_batch);
+    size_t left = 0;
+    while (requests.pop_batch(batch, params.max_batch, std::chrono::milliseconds(params.max_wait_ms),
+                              [this]{return isCancelled();}, &left))
+    {
+        setProgress((float)left / (float)params.queue_capacity);
+        infer(batch);
+        //release the frames before waiting for the next batch
+        batch.clear();
+    }
+    requests.clear();
+}
+
+void RoiInferenceStage::cancel()
+{
+    Poco::Task::cancel();
+    requests.wake_all();
+}
+
+double RoiInferenceStage::batch_fill_ratio() const
+{
+    uint64_t b = counters.batches.load();
+    return b > 0 ? (double)counters.inferred.load() / (double)(b * params.max_batch) : 0.0;
+}
+
+double RoiInferenceStage::mean_queue_latency_ms() const
+{
+    uint64_t n = counters.inferred.load();
+    return n > 0 ? (double)counters.latency_usec_sum.load() / 1000.0 / (double)n : 0.0;
+}
+
+}//ZMBEntities
@@ -0,0 +1,143 @@
+#ifndef ROI_INFERENCE_STAGE_H
+#define ROI_INFERENCE_STAGE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <Poco/Task.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/dnn.hpp>
+#include "../src/mimage.h"
+#include "../src/minor/cancellable_queue.hpp"
+
+namespace ZMBEntities {
+
+struct RoiInferenceParams
+{
+    std::string model_path;   //< cv::dnn::readNet() model, a small classifier
+    std::string config_path;  //< may be empty
+    int input_width = 96;
+    int input_height = 96;
+    double scale = 1.0 / 255.0;
+    cv::Scalar mean;
+    bool swap_rb = true;      //< crops are BGR, most models want RGB
+    float margin = 0.15f;     //< the crop is the region enlarged by this part of it's size
+
+    size_t max_batch = 16;    //< crops of all the cameras in one forward pass
+    int max_wait_ms = 20;     //< max time to wait for a batch to fill
+    size_t queue_capacity = 256;
+
+    double camera_rate = 2.0; //< crops per second per camera
+    double camera_burst = 4.0;//< crops a camera may send at once
+};
+
+/** Classification of one motion crop.*/
+struct RoiResult
+{
+    uint32_t camera;
+    int64_t ts_usec;
+    ZMB::MRegion region;//< in the frame's coordinates, before the margin
+    uint32_t track_id;
+    int class_id;
+    float score;
+    double queue_latency_ms;//< submit() -> start of the forward pass
+};
+
+/** Shared CPU inference on the motion crops of many cameras.
+ *
+ * The motion path submit()s the regions of a decoded frame (the frame is shared, not copied),
+ * each camera is rate-limited with a token bucket so a busy scene can't starve the others.
+ * The task collects up to (max_batch) crops for at most (max_wait_ms),
+ * converts them to the network's input (crop + scale + BGR in one sws_scale)
+ * and runs one forward pass for the whole batch.
+ * The cost follows the amount of motion, not the number of cameras.
+ * Task's progress reported to the TaskManager is the queue fill level.*/
+class RoiInferenceStage : public Poco::Task
+{
+public:
+    typedef std::function<void(const RoiResult&)> OnResultAction;
+
+    /** Counters, may be read from any thread.*/
+    struct Stats
+    {
+        Stats() { submitted = 0; rate_limited = 0; dropped = 0; inferred = 0; batches = 0;
+                  latency_usec_sum = 0; latency_usec_max = 0; }
+        std::atomic<uint64_t> submitted;
+        std::atomic<uint64_t> rate_limited;//< refused by the camera's token bucket
+        std::atomic<uint64_t> dropped;     //< refused by the full queue
+        std::atomic<uint64_t> inferred;
+        std::atomic<uint64_t> batches;
+        std::atomic<uint64_t> latency_usec_sum;
+        std::atomic<uint64_t> latency_usec_max;
+    };
+
+    RoiInferenceStage(const std::string& name, const RoiInferenceParams& params);
+    virtual ~RoiInferenceStage();
+
+    /** Read the network, must be called before the task is started.
+     * @return FALSE if the model can't be loaded.*/
+    bool load();
+
+    /** Enqueue a region of the frame, never blocks.
+     * @return FALSE if refused by the rate limit or the queue's capacity.*/
+    bool submit(uint32_t camera, int64_t ts_usec, const ZMB::PictureSharedPtr& frame,
+                const ZMB::MRegion& region, uint32_t track_id = 0);
+
+    /** Processing loop, exits on cancel().*/
+    void runTask() override;
+
+    /** Cancels the task and wakes up the processing loop.*/
+    void cancel() override;
+
+    const Stats& stats() const {return counters;}
+    /** Mean part of the batch capacity used by the forward passes.*/
+    double batch_fill_ratio() const;
+    /** Mean time a crop waited in the queue, milliseconds.*/
+    double mean_queue_latency_ms() const;
+
+    //should be set before the task is started, called from the task's thread
+    OnResultAction onResult;
+
+    const RoiInferenceParams params;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request
+    {
+        uint32_t camera;
+        int64_t ts_usec;
+        ZMB::PictureSharedPtr frame;
+        ZMB::MRegion region;
+        uint32_t track_id;
+        Clock::time_point enqueued;
+    };
+
+    struct TokenBucket
+    {
+        double tokens;
+        Clock::time_point last;
+    };
+
+    bool take_token(uint32_t camera, Clock::time_point now);
+    void infer(std::vector<Request>& batch);
+    /** Crop the region (with the margin) into the network's input size, BGR24.*/
+    bool crop(const Request& req, cv::Mat& dst);
+
+    cv::dnn::Net net;
+    ZMB::SwsUniquePtr sws;
+
+    ZMB::CancellableQueue<Request> requests;
+    std::mutex buckets_mutex;
+    std::unordered_map<uint32_t, TokenBucket> buckets;//< guarded by the buckets_mutex
+
+    Stats counters;
+};
+
+}//ZMBEntities
+
+#endif // ROI_INFERENCE_STAGE_H
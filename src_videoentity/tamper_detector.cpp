@@ -0,0 +1,113 @@
+#include "tamper_detector.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace ZMBEntities {
+
+TamperDetector::TamperDetector()
+{
+    reset();
+}
+
+void TamperDetector::reset()
+{
+    last_stddev = 0.0;
+    last_sharpness = 0.0;
+    last_hist_shift = 0.0;
+    ref_hist.release();
+    ref_sharpness = 0.0;
+    analyses = 0;
+    next_usec = 0;
+    for (Condition& c : conds)
+        c = Condition();
+}
+
+void TamperDetector::update(Kind kind, bool raw, float score, int64_t ts_usec, std::vector<Change>& changes)
+{
+    Condition& c(conds[kind]);
+    if (raw == c.active)
+    {
+        c.since = -1;
+        return;
+    }
+    if (c.since < 0)
+        c.since = ts_usec;
+    if (ts_usec - c.since < params.hold_usec)
+        return;
+    c.active = raw;
+    c.since = -1;
+    changes.push_back(Change{kind, raw, score});
+}
+
+bool TamperDetector::process(const cv::Mat& bgr, float motion_ratio, int64_t ts_usec, std::vector<Change>& changes)
+{
+    changes.clear();
+    if (bgr.empty() || ts_usec < next_usec)
+        return false;
+    next_usec = ts_usec + params.period_usec;
+
+    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+
+    cv::Scalar mean, dev;
+    cv::meanStdDev(gray, mean, dev);
+    last_stddev = dev[0];
+
+    cv::Laplacian(gray, laplacian, CV_16S);
+    cv::meanStdDev(laplacian, mean, dev);
+    last_sharpness = dev[0] * dev[0];
+
+    const int channels[] = {0};
+    const int bins[] = {32};
+    const float range[] = {0.0f, 256.0f};
+    const float* ranges[] = {range};
+    cv::calcHist(&gray, 1, channels, cv::Mat(), hist, 1, bins, ranges);
+    cv::normalize(hist, hist, 1.0, 0.0, cv::NORM_L1);
+
+    if (ref_hist.empty() || analyses < params.warmup)
+    {//learn the reference from the scene
+        double w = 1.0 / (analyses + 1);
+        if (ref_hist.empty())
+            ref_hist = hist.clone();
+        else
+            cv::addWeighted(ref_hist, 1.0 - w, hist, w, 0.0, ref_hist);
+        ref_sharpness += w * (last_sharpness - ref_sharpness);
+        ++analyses;
+        last_hist_shift = 0.0;
+        return true;
+    }
+
+    last_hist_shift = cv::compareHist(hist, ref_hist, cv::HISTCMP_BHATTACHARYYA);
+    double sharpness_ratio = ref_sharpness > 0.0 ? last_sharpness / ref_sharpness : 1.0;
+
+    bool covered = last_stddev < params.covered_stddev && last_hist_shift > params.covered_hist_shift;
+    bool defocused = !covered && sharpness_ratio < params.defocus_ratio;
+    bool moved = !covered && last_hist_shift > params.moved_hist_shift
+            && motion_ratio > params.moved_motion_ratio;
+
+    update(Covered, covered, (float)last_stddev, ts_usec, changes);
+    update(Defocused, defocused, (float)sharpness_ratio, ts_usec, changes);
+    update(Moved, moved, (float)last_hist_shift, ts_usec, changes);
+
+    for (const Change& ch : changes)
+    {
+        if (Moved == ch.kind && ch.active)
+        {//the new view becomes the reference, the condition clears after (hold_usec)
+            analyses = 0;
+            ref_hist.release();
+            ref_sharpness = 0.0;
+        }
+    }
+
+    bool normal = true;
+    for (const Condition& c : conds)
+        normal = normal && !c.active && c.since < 0;
+    if (normal && !ref_hist.empty())
+    {//follow the slow changes of the scene: daylight, seasons
+        cv::addWeighted(ref_hist, 1.0 - params.learn_alpha, hist, params.learn_alpha, 0.0, ref_hist);
+        ref_sharpness += params.learn_alpha * (last_sharpness - ref_sharpness);
+    }
+    ++analyses;
+    return true;
+}
+
+}//ZMBEntities
@@ -0,0 +1,84 @@
+#ifndef TAMPER_DETECTOR_H
+#define TAMPER_DETECTOR_H
+
+#include <vector>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+
+namespace ZMBEntities {
+
+struct TamperParams
+{
+    int64_t period_usec = 500 * 1000;     //< analysis rate, the thumbnails in between are ignored
+    int64_t hold_usec = 3 * 1000 * 1000;  //< a condition must last that long to be raised or cleared
+    double learn_alpha = 0.05;            //< reference's update weight per analysis, while all is normal
+    int warmup = 10;                      //< analyses before the reference is trusted
+
+    double covered_stddev = 10.0;         //< luma deviation below it: a uniform picture
+    double covered_hist_shift = 0.4;      //< and the histogram moved away from the reference
+    double defocus_ratio = 0.35;          //< sharpness below this part of the reference's
+    double moved_hist_shift = 0.3;        //< Bhattacharyya distance to the reference histogram
+    double moved_motion_ratio = 0.5;      //< and that part of the frame is moving
+};
+
+/** Detects a covered, defocused or moved camera from the detector's thumbnails,
+ * no extra decoding nor scaling:
+ * - histogram shift : Bhattacharyya distance of the 32-bin luma histogram to the reference one;
+ * - sharpness : variance of the Laplacian;
+ * - global motion fraction : MOG2's foreground ratio of the frame.
+ * The reference (histogram, sharpness) slowly follows the scene while there is no tamper,
+ * so day/night changes are not reported. A moved camera is a pulse: it's raised,
+ * the reference is re-learnt for the new view and the condition clears.
+ * Not thread-safe: one per detector.*/
+class TamperDetector
+{
+public:
+    enum Kind { Covered = 0, Defocused = 1, Moved = 2, KINDS_NUM = 3 };
+
+    /** A raised or cleared condition.*/
+    struct Change
+    {
+        Kind kind;
+        bool active;
+        float score;//< the metric that triggered: deviation, sharpness ratio, histogram shift
+    };
+
+    TamperDetector();
+
+    /** @param bgr -- the thumbnail, CV_8UC3.
+     * @param motion_ratio -- part of the frame's pixels in motion.
+     * @return TRUE if the analysis ran on this frame, (changes) are filled then.*/
+    bool process(const cv::Mat& bgr, float motion_ratio, int64_t ts_usec, std::vector<Change>& changes);
+
+    bool is_active(Kind kind) const {return conds[kind].active;}
+    void reset();
+
+    TamperParams params;
+
+    //last computed metrics
+    double last_stddev;
+    double last_sharpness;
+    double last_hist_shift;
+
+private:
+    struct Condition
+    {
+        bool active = false;
+        int64_t since = -1;//< when the raw value started to differ from (active), -1: it does not
+    };
+
+    void update(Kind kind, bool raw, float score, int64_t ts_usec, std::vector<Change>& changes);
+
+    cv::Mat gray;
+    cv::Mat laplacian;
+    cv::Mat hist;
+    cv::Mat ref_hist;
+    double ref_sharpness;
+    int analyses;
+    int64_t next_usec;
+    Condition conds[KINDS_NUM];
+};
+
+}//ZMBEntities
+
+#endif // TAMPER_DETECTOR_H
@@ -0,0 +1,248 @@
+#include "zone_index.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace ZMBEntities {
+
+ZoneIndex::ZoneIndex(int cell_size) : cell_size(std::max(1, cell_size))
+{
+    clear();
+}
+
+void ZoneIndex::clear()
+{
+    bounds.clear();
+    kinds.clear();
+    poly_start.assign(1, 0);
+    poly_pts.clear();
+    gx0 = gy0 = 0;
+    gw = gh = 0;
+    cell_start.assign(1, 0);
+    cell_zones.clear();
+    stamp.clear();
+    stamp_cnt = 0;
+}
+
+uint32_t ZoneIndex::add_bounds(int l, int b, int r, int t, int kind)
+{
+    bounds.push_back(l, b, r, t);
+    kinds.push_back(kind);
+    return (uint32_t)(kinds.size() - 1);
+}
+
+uint32_t ZoneIndex::add_rectangle(const ZMB::MRegion& r)
+{
+    return add_bounds(r.left(), r.bottom(), r.right(), r.top(), -1);
+}
+
+uint32_t ZoneIndex::add_polygon(const glm::ivec2* pts, int len)
+{
+    int l = INT_MAX, b = INT_MAX, r = INT_MIN, t = INT_MIN;
+    for (int i = 0; i < len; ++i)
+    {
+        l = std::min(l, pts[i].x);
+        b = std::min(b, pts[i].y);
+        r = std::max(r, pts[i].x + 1);
+        t = std::max(t, pts[i].y + 1);
+        poly_pts.push_back(pts[i]);
+    }
+    if (len <= 0)
+        l = b = r = t = 0;
+    poly_start.push_back((uint32_t)poly_pts.size());
+    return add_bounds(l, b, r, t, (int)poly_start.size() - 2);
+}
+
+void ZoneIndex::build()
+{
+    stamp.assign(kinds.size(), 0);
+    stamp_cnt = 0;
+    cell_zones.clear();
+    if (kinds.empty())
+    {
+        gw = gh = 0;
+        cell_start.assign(1, 0);
+        return;
+    }
+
+    int l = *std::min_element(bounds.l.begin(), bounds.l.end());
+    int b = *std::min_element(bounds.b.begin(), bounds.b.end());
+    int r = *std::max_element(bounds.r.begin(), bounds.r.end());
+    int t = *std::max_element(bounds.t.begin(), bounds.t.end());
+    gx0 = l;
+    gy0 = b;
+    gw = std::max(1, (r - l + cell_size - 1) / cell_size);
+    gh = std::max(1, (t - b + cell_size - 1) / cell_size);
+
+    //count, prefix sum, fill
+    cell_start.assign((size_t)gw * gh + 1, 0);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        std::vector<uint32_t> fill;
+        if (1 == pass)
+        {
+            for (size_t c = 1; c < cell_start.size(); ++c)
+                cell_start[c] += cell_start[c - 1];
+            cell_zones.resize(cell_start.back());
+            fill.assign(cell_start.begin(), cell_start.end() - 1);
+        }
+        for (uint32_t z = 0; z < kinds.size(); ++z)
+        {
+            if (bounds.r[z] <= bounds.l[z] || bounds.t[z] <= bounds.b[z])
+                continue;
+            int cx0 = (bounds.l[z] - gx0) / cell_size, cx1 = (bounds.r[z] - 1 - gx0) / cell_size;
+            int cy0 = (bounds.b[z] - gy0) / cell_size, cy1 = (bounds.t[z] - 1 - gy0) / cell_size;
+            for (int cy = cy0; cy <= cy1; ++cy)
+                for (int cx = cx0; cx <= cx1; ++cx)
+                {
+                    size_t c = (size_t)cy * gw + cx;
+                    if (0 == pass)
+                        ++cell_start[c + 1];
+                    else
+                        cell_zones[fill[c]++] = z;
+                }
+        }
+    }
+}
+
+bool ZoneIndex::polygon_contains(int poly, int x, int y) const
+{//even-odd crossings of the ray to +x, the vertices exactly on the ray count as above it
+    const glm::ivec2* p = poly_pts.data() + poly_start[poly];
+    int n = (int)(poly_start[poly + 1] - poly_start[poly]);
+    bool inside = false;
+    for (int i = 0, j = n - 1; i < n; j = i++)
+    {
+        if ((p[i].y > y) == (p[j].y > y))
+            continue;
+        //x of the crossing > x, exactly: (x - xi) * (yj - yi) < (xj - xi) * (y - yi), sign of (yj - yi)
+        int64_t lhs = (int64_t)(x - p[i].x) * (p[j].y - p[i].y);
+        int64_t rhs = (int64_t)(p[j].x - p[i].x) * (y - p[i].y);
+        if ((p[j].y > p[i].y) ? lhs < rhs : lhs > rhs)
+            inside = !inside;
+    }
+    return inside;
+}
+
+bool ZoneIndex::contains(uint32_t zone, int x, int y) const
+{
+    if (x < bounds.l[zone] || x >= bounds.r[zone] || y < bounds.b[zone] || y >= bounds.t[zone])
+        return false;
+    return kinds[zone] < 0 || polygon_contains(kinds[zone], x, y);
+}
+
+/** Does the segment (a, b) cross the box [l, r] x [b, t]? Liang-Barsky clipping.*/
+static bool SegmentHitsBox(const glm::ivec2& p0, const glm::ivec2& p1, int l, int b, int r, int t)
+{
+    double t0 = 0.0, t1 = 1.0;
+    double dx = p1.x - p0.x, dy = p1.y - p0.y;
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {(double)p0.x - l, (double)r - p0.x, (double)p0.y - b, (double)t - p0.y};
+    for (int i = 0; i < 4; ++i)
+    {
+        if (0.0 == p[i])
+        {
+            if (q[i] < 0.0)
+                return false;
+            continue;
+        }
+        double u = q[i] / p[i];
+        if (p[i] < 0.0)
+            t0 = std::max(t0, u);
+        else
+            t1 = std::min(t1, u);
+        if (t0 > t1)
+            return false;
+    }
+    return true;
+}
+
+bool ZoneIndex::overlaps(uint32_t zone, int l, int b, int r, int t) const
+{
+    if (r <= bounds.l[zone] || l >= bounds.r[zone] || t <= bounds.b[zone] || b >= bounds.t[zone])
+        return false;
+    int poly = kinds[zone];
+    if (poly < 0)
+        return true;
+
+    //the box's pixels are [l, r - 1] x [b, t - 1]
+    if (polygon_contains(poly, l, b))
+        return true;
+    const glm::ivec2* p = poly_pts.data() + poly_start[poly];
+    int n = (int)(poly_start[poly + 1] - poly_start[poly]);
+    for (int i = 0, j = n - 1; i < n; j = i++)
+    {
+        if (SegmentHitsBox(p[j], p[i], l, b, r - 1, t - 1))
+            return true;
+    }
+    return false;
+}
+
+size_t ZoneIndex::query_points(const glm::ivec2* pts, size_t n, std::vector<ZoneHit>& hits)
+{
+    size_t before = hits.size();
+    if (kinds.empty())
+        return 0;
+    for (size_t q = 0; q < n; ++q)
+    {
+        int x = pts[q].x, y = pts[q].y;
+        int cx = x - gx0, cy = y - gy0;
+        if (cx < 0 || cy < 0)
+            continue;
+        cx /= cell_size;
+        cy /= cell_size;
+        if (cx >= gw || cy >= gh)
+            continue;
+        size_t c = (size_t)cy * gw + cx;
+        for (uint32_t k = cell_start[c]; k < cell_start[c + 1]; ++k)
+        {
+            uint32_t z = cell_zones[k];
+            if (contains(z, x, y))
+                hits.push_back(ZoneHit{(uint32_t)q, z});
+        }
+    }
+    return hits.size() - before;
+}
+
+size_t ZoneIndex::query_boxes(const ZMB::MRegion* boxes, size_t n, std::vector<ZoneHit>& hits)
+{
+    size_t before = hits.size();
+    if (kinds.empty())
+        return 0;
+    for (size_t q = 0; q < n; ++q)
+    {
+        int l = boxes[q].left(), b = boxes[q].bottom(), r = boxes[q].right(), t = boxes[q].top();
+        if (r <= l || t <= b)
+            continue;
+        int cx0 = std::max(0, (l - gx0) / cell_size), cx1 = std::min(gw - 1, (r - 1 - gx0) / cell_size);
+        int cy0 = std::max(0, (b - gy0) / cell_size), cy1 = std::min(gh - 1, (t - 1 - gy0) / cell_size);
+        if (r - 1 < gx0 || t - 1 < gy0 || cx0 > cx1 || cy0 > cy1)
+            continue;
+
+        //a zone is referenced from several cells: test it once per box
+        if (0 == ++stamp_cnt)
+        {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            stamp_cnt = 1;
+        }
+        size_t first = hits.size();
+        for (int cy = cy0; cy <= cy1; ++cy)
+            for (int cx = cx0; cx <= cx1; ++cx)
+            {
+                size_t c = (size_t)cy * gw + cx;
+                for (uint32_t k = cell_start[c]; k < cell_start[c + 1]; ++k)
+                {
+                    uint32_t z = cell_zones[k];
+                    if (stamp[z] == stamp_cnt)
+                        continue;
+                    stamp[z] = stamp_cnt;
+                    if (overlaps(z, l, b, r, t))
+                        hits.push_back(ZoneHit{(uint32_t)q, z});
+                }
+            }
+        std::sort(hits.begin() + first, hits.end(),
+                  [](const ZoneHit& a, const ZoneHit& b) { return a.zone < b.zone; });
+    }
+    return hits.size() - before;
+}
+
+}//ZMBEntities
@@ -0,0 +1,78 @@
+#ifndef ZONE_INDEX_H
+#define ZONE_INDEX_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "glm/vec2.hpp"
+#include "../src/mregion_batch.h"
+
+namespace ZMBEntities {
+
+/** A zone containing (or overlapping) the query's point (box).*/
+struct ZoneHit
+{
+    uint32_t query;//< index in the batch
+    uint32_t zone; //< ZoneIndex's id
+};
+
+/** Uniform grid over the zones of a camera: rectangles (MRegion) and polygons
+ * in image coordinates, for the batched "which zones contain these blobs" queries.
+ *
+ * A zone is referenced from every cell its bounding box covers (CSR arrays),
+ * a query tests only the zones of its cells: O(hits) for hundreds of zones.
+ * The rectangles are [left, right) x [bottom, top), see ZMB::MakeRegion();
+ * the polygons are simple (even-odd rule) of integer vertices: the same outlines as
+ * the zone masks, see JVa::Workspace::triangulate_outline().
+ * Usage: add_*(), build(), then the queries. Not thread-safe: the queries use scratch memory.*/
+class ZoneIndex
+{
+public:
+    explicit ZoneIndex(int cell_size = 64);
+
+    void clear();
+
+    /** @return the zone's id: ids go from 0 in the order of adding.*/
+    uint32_t add_rectangle(const ZMB::MRegion& r);
+    uint32_t add_polygon(const glm::ivec2* pts, int len);
+
+    /** Bucket the zones, call after adding.*/
+    void build();
+
+    /** Appends to (hits) the zones containing each of the points, in the order of the points.
+     * @return the number of the hits appended.*/
+    size_t query_points(const glm::ivec2* pts, size_t n, std::vector<ZoneHit>& hits);
+
+    /** Same for the zones overlapping the boxes, ordered by the zone per box.
+     * A polygon overlaps a box if its outline crosses the box's pixel centres' rectangle,
+     * even without a pixel centre inside.*/
+    size_t query_boxes(const ZMB::MRegion* boxes, size_t n, std::vector<ZoneHit>& hits);
+
+    size_t size() const {return kinds.size();}
+    bool is_polygon(uint32_t zone) const {return 0 <= kinds[zone];}
+
+    const int cell_size;
+
+private:
+    bool contains(uint32_t zone, int x, int y) const;
+    bool overlaps(uint32_t zone, int l, int b, int r, int t) const;
+    bool polygon_contains(int poly, int x, int y) const;
+    uint32_t add_bounds(int l, int b, int r, int t, int kind);
+
+    ZMB::MRegionBatch bounds;//< zones' bounding boxes
+    std::vector<int> kinds;//< -1: rectangle, else the polygon's index
+    std::vector<uint32_t> poly_start;//< polygon's first vertex in (poly_pts), size + 1
+    std::vector<glm::ivec2> poly_pts;
+
+    //grid
+    int gx0, gy0, gw, gh;
+    std::vector<uint32_t> cell_start;//< CSR: zones of the cell c are cell_zones[cell_start[c] .. cell_start[c + 1])
+    std::vector<uint32_t> cell_zones;
+
+    std::vector<uint32_t> stamp;//< last box query that tested the zone
+    uint32_t stamp_cnt;
+};
+
+}//ZMBEntities
+
+#endif // ZONE_INDEX_H
@@ -0,0 +1,192 @@
+#include "zone_rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../src/minor/cpu_dispatch.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if ZMB_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace ZMBEntities {
+
+static constexpr int64_t ONE = 1 << ZoneRasterizer::SUBPIXEL_BITS;
+
+static inline int64_t FloorDiv(int64_t n, int64_t d)
+{//d > 0
+    return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
+
+static inline int64_t CeilDiv(int64_t n, int64_t d)
+{//d > 0
+    return n >= 0 ? (n + d - 1) / d : -((-n) / d);
+}
+
+/** Edge a->b of a counterclockwise triangle: E(x, y) = A * x + B(y) >= 0 inside.
+ * The row's bound x = -B(y) / A is linear in y: it's stepped as an exact
+ * quotient and remainder, no divisions per row.*/
+struct EdgeFn
+{
+    int64_t dy_num = 0;  //< B(y) step per row
+    int64_t B = 0;       //< B of the current row
+    int64_t den = 1;     //< |A| * ONE
+    int64_t q = 0, r = 0;    //< bound's numerator = q * den + r, 0 <= r < den
+    int64_t qs = 0, rs = 0;  //< numerator's step per row, same form
+    bool lower = false;      //< the edge bounds the span from the left
+    bool horizontal = false;
+    bool inclusive = false;  //< the pixels on the edge belong to this triangle
+
+    void setup(int64_t ax, int64_t ay, int64_t bx, int64_t by, int64_t row)
+    {
+        int64_t A = ay - by;
+        int64_t dx = bx - ax;
+        inclusive = A > 0 || (0 == A && bx > ax);
+        horizontal = 0 == A;
+        lower = A > 0;
+        //B(y) = dx * (y - ay) + (by - ay) * ax
+        B = dx * (row * ONE - ay) + (by - ay) * ax;
+        dy_num = dx * ONE;
+        if (horizontal)
+            return;
+        den = (lower ? A : -A) * ONE;
+        //lower: x >= -B / (A * ONE), upper: x <= B / (-A * ONE)
+        int64_t num = lower ? -B : B;
+        int64_t step = lower ? -dy_num : dy_num;
+        q = FloorDiv(num, den);
+        r = num - q * den;
+        qs = FloorDiv(step, den);
+        rs = step - qs * den;
+    }
+
+    /** Narrow [x0, x1] to the current row's part inside the edge.*/
+    inline void clip(int64_t& x0, int64_t& x1) const
+    {
+        if (horizontal)
+        {
+            if (B < 0 || (0 == B && !inclusive))
+                x1 = x0 - 1;
+        }
+        else if (lower)
+            x0 = std::max(x0, inclusive ? q + (0 != r) : q + 1);
+        else
+            x1 = std::min(x1, inclusive ? q : q + (0 != r) - 1);
+    }
+
+    inline void next_row()
+    {
+        B += dy_num;
+        q += qs;
+        r += rs;
+        //the carry is random from row to row: no branch
+        int64_t carry = r >= den;
+        r -= carry * den;
+        q += carry;
+    }
+};
+
+typedef void (*FillSpanFn)(uint8_t* dst, int len, uint8_t value);
+
+static void FillSpanScalar(uint8_t* dst, int len, uint8_t value)
+{
+    for (int c = 0; c < len; ++c)
+        dst[c] = value;
+}
+
+#ifdef __SSE2__
+static void FillSpanSSE2(uint8_t* dst, int len, uint8_t value)
+{
+    int c = 0;
+    const __m128i v = _mm_set1_epi8((char)value);
+    for (; c + 16 <= len; c += 16)
+        _mm_storeu_si128((__m128i*)(dst + c), v);
+    FillSpanScalar(dst + c, len - c, value);
+}
+#else
+static const FillSpanFn FillSpanSSE2 = nullptr;
+#endif
+
+#if ZMB_SIMD_X86
+ZMB_TARGET_AVX2 static void FillSpanAVX2(uint8_t* dst, int len, uint8_t value)
+{
+    int c = 0;
+    const __m256i v = _mm256_set1_epi8((char)value);
+    for (; c + 32 <= len; c += 32)
+        _mm256_storeu_si256((__m256i*)(dst + c), v);
+    if (c + 16 <= len)
+    {
+        _mm_storeu_si128((__m128i*)(dst + c), _mm256_castsi256_si128(v));
+        c += 16;
+    }
+    FillSpanScalar(dst + c, len - c, value);
+}
+#else
+static const FillSpanFn FillSpanAVX2 = nullptr;
+#endif
+
+void ZoneRasterizer::FillSpan(uint8_t* dst, int len, uint8_t value)
+{//the spans are short: 512-bit stores don't pay off, AVX-512 CPUs take the AVX2 one
+    static const FillSpanFn fn = ZMB::SelectKernel<FillSpanFn>(FillSpanScalar, FillSpanSSE2, FillSpanAVX2);
+    fn(dst, len, value);
+}
+
+void ZoneRasterizer::FillTriangle(uint8_t* data, int stride, int width, int height,
+                                  const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, uint8_t value)
+{
+    int64_t X[3] = {std::llround(a.x * ONE), std::llround(b.x * ONE), std::llround(c.x * ONE)};
+    int64_t Y[3] = {std::llround(a.y * ONE), std::llround(b.y * ONE), std::llround(c.y * ONE)};
+
+    int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+    if (0 == area)
+        return;
+    if (area < 0)
+    {
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+    }
+
+    int64_t ymin = std::max<int64_t>(0, CeilDiv(std::min({Y[0], Y[1], Y[2]}), ONE));
+    int64_t ymax = std::min<int64_t>(height - 1, FloorDiv(std::max({Y[0], Y[1], Y[2]}), ONE));
+    int64_t xmin = std::max<int64_t>(0, CeilDiv(std::min({X[0], X[1], X[2]}), ONE));
+    int64_t xmax = std::min<int64_t>(width - 1, FloorDiv(std::max({X[0], X[1], X[2]}), ONE));
+    if (ymin > ymax || xmin > xmax)
+        return;
+
+    EdgeFn edges[3];
+    for (int e = 0; e < 3; ++e)
+        edges[e].setup(X[e], Y[e], X[(e + 1) % 3], Y[(e + 1) % 3], ymin);
+
+    for (int64_t y = ymin; y <= ymax; ++y)
+    {
+        int64_t x0 = xmin, x1 = xmax;
+        for (int e = 0; e < 3; ++e)
+        {
+            edges[e].clip(x0, x1);
+            edges[e].next_row();
+        }
+        if (x0 <= x1)
+            FillSpan(data + y * stride + x0, (int)(x1 - x0 + 1), value);
+    }
+}
+
+int ZoneRasterizer::FillFaces(cv::Mat& mask, const JVa::Workspace& ws, float sx, float sy, uint8_t value)
+{
+    int filled = 0;
+    int a = 0, b = 0, c = 0;
+    for (int f = 0; f < ws.faces_used; ++f)
+    {
+        if (!ws.face_vertices(f, a, b, c) || (!ws.inside.empty() && 0 == ws.inside[f]))
+            continue;
+        FillTriangle(mask,
+                     glm::vec2(ws.x[a] * sx, ws.y[a] * sy),
+                     glm::vec2(ws.x[b] * sx, ws.y[b] * sy),
+                     glm::vec2(ws.x[c] * sx, ws.y[c] * sy), value);
+        ++filled;
+    }
+    return filled;
+}
+
+}//ZMBEntities
@@ -0,0 +1,47 @@
+#ifndef ZONE_RASTERIZER_H
+#define ZONE_RASTERIZER_H
+
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+#include "glm/vec2.hpp"
+#include "delaunay/Triangulation.h"
+
+namespace ZMBEntities {
+
+/** Fills triangles into CV_8UC1 masks, for the zones: the triangulated polygons
+ * go to a mask without an intermediate polygon list.
+ *
+ * The pixel (x, y) is filled if the point (x, y) is inside the triangle,
+ * i.e. the vertices are at the pixels' centres as for cv::fillPoly().
+ * The coordinates are snapped to 1/2^SUBPIXEL_BITS of a pixel and the edge functions
+ * are evaluated in 64-bit integers: each row's span is solved directly, no per-pixel tests.
+ * The pixels exactly on an edge go to one triangle only (top-left rule), so the adjacent
+ * triangles neither overlap nor leave gaps.*/
+class ZoneRasterizer
+{
+public:
+    /** Sub-pixel precision of the vertices, the coordinates must fit in 2^(30 - SUBPIXEL_BITS).*/
+    static constexpr int SUBPIXEL_BITS = 4;
+
+    /** Fill the triangle (a, b, c), any winding, clipped to the mask.*/
+    static void FillTriangle(uint8_t* data, int stride, int width, int height,
+                             const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, uint8_t value);
+
+    static void FillTriangle(cv::Mat& mask, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c,
+                             uint8_t value)
+    {
+        FillTriangle(mask.data, (int)mask.step[0], mask.cols, mask.rows, a, b, c, value);
+    }
+
+    /** Fill the inner faces of the triangulation, or the faces inside the outline after
+     * JVa::Workspace::triangulate_outline(); the coordinates are scaled by (sx, sy).
+     * @return the number of triangles.*/
+    static int FillFaces(cv::Mat& mask, const JVa::Workspace& ws, float sx, float sy, uint8_t value);
+
+    /** memset() of the spans: 16 or 32 bytes per store, see ZMB::ActiveSimd().*/
+    static void FillSpan(uint8_t* dst, int len, uint8_t value);
+};
+
+}//ZMBEntities
+
+#endif // ZONE_RASTERIZER_H